@@ -0,0 +1,463 @@
+#include "meshlife/algorithms/helpers.h"
+#include "meshlife/algorithms/lenia_simd.h"
+#include "meshlife/algorithms/mesh_gol.h"
+#include "meshlife/algorithms/mesh_lenia.h"
+#include "meshlife/algorithms/mesh_lenia_batch.h"
+#include "meshlife/mesh_buffers.h"
+#include <pmp/algorithms/differential_geometry.h>
+#include <pmp/algorithms/shapes.h>
+#include <pmp/algorithms/utilities.h>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+
+/// Lenia neighborhood radius in mean edge lengths, the default of meshlife_sim
+const float LENIA_RADIUS = 8;
+
+/// Options named after the Google Benchmark flags, so its tools (e.g. compare.py) work on the JSON output
+struct Options
+{
+    std::string filter = ".*";
+    double min_time = 0.5;
+    std::string out;
+    std::string format = "console";
+    bool list = false;
+};
+
+/// Generated test mesh, faces are sorted spatially like in the viewer
+struct MeshCase
+{
+    std::string name;
+    std::function<pmp::SurfaceMesh()> generate;
+    bool closed;
+};
+
+/// A benchmark prepares its data in setup(), which returns the body that is timed
+struct Benchmark
+{
+    std::string name;
+    std::shared_ptr<pmp::SurfaceMesh> mesh;
+    std::function<std::function<void()>()> setup;
+};
+
+struct Result
+{
+    std::string name;
+    size_t iterations;
+    double real_time; ///< wall time per iteration in microseconds
+    double cpu_time;  ///< process CPU time (all threads) per iteration in microseconds
+    size_t faces;
+};
+
+/// Discards std::cout while in scope, the automatons log their precomputations there
+struct MuteStdout
+{
+    MuteStdout() : buffer_(std::cout.rdbuf(nullptr))
+    {
+    }
+    ~MuteStdout()
+    {
+        std::cout.rdbuf(buffer_);
+    }
+    std::streambuf* buffer_;
+};
+
+void print_usage(const char* name)
+{
+    std::cout << "Usage: " << name << " [options]\n"
+              << "Runs the automaton, precomputation and rendering preparation benchmarks on generated meshes.\n\n"
+              << "  --benchmark_filter=<regex>          only run benchmarks whose name matches (.*)\n"
+              << "  --benchmark_min_time=<seconds>      minimum measured time per benchmark (0.5)\n"
+              << "  --benchmark_out=<file>              additionally write the results as JSON to <file>\n"
+              << "  --benchmark_format=<console|json>   format of the standard output (console)\n"
+              << "  --benchmark_list_tests              list the benchmark names and exit\n";
+}
+
+bool parse_flag(const std::string& arg, const std::string& flag, std::string& value)
+{
+    const std::string prefix = "--" + flag + "=";
+    if (arg.rfind(prefix, 0) != 0)
+        return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+std::vector<MeshCase> mesh_cases()
+{
+    std::vector<MeshCase> cases;
+    for (int level : {4, 5, 6})
+        cases.push_back({"quad_sphere:" + std::to_string(level), [=] { return pmp::quad_sphere(level); }, true});
+    for (int level : {3, 4, 5})
+        cases.push_back({"icosphere:" + std::to_string(level), [=] { return pmp::icosphere(level); }, true});
+    for (int level : {4, 5})
+    {
+        // hexagons and pentagons, which need the full polygon tessellation
+        cases.push_back({"dual_icosphere:" + std::to_string(level),
+                         [=] {
+                             pmp::SurfaceMesh mesh = pmp::icosphere(level);
+                             pmp::dual(mesh);
+                             return mesh;
+                         },
+                         true});
+    }
+    for (int resolution : {24, 48, 96})
+    {
+        cases.push_back({"torus:" + std::to_string(resolution),
+                         [=] { return pmp::torus(resolution, 2 * resolution); },
+                         true});
+    }
+    for (int resolution : {32, 64, 128})
+        cases.push_back({"plane:" + std::to_string(resolution), [=] { return pmp::plane(resolution); }, false});
+    return cases;
+}
+
+std::unique_ptr<meshlife::MeshLenia> make_lenia(pmp::SurfaceMesh& mesh, meshlife::LeniaBackend backend)
+{
+    MuteStdout mute;
+    auto lenia = std::make_unique<meshlife::MeshLenia>(mesh, false);
+    lenia->p_neighborhood_radius_ = LENIA_RADIUS * lenia->average_edge_length_;
+    lenia->p_backend_ = backend;
+    lenia->allocate_needed_properties();
+    srand(0);
+    lenia->init_state_random();
+    return lenia;
+}
+
+std::vector<Benchmark> register_benchmarks()
+{
+    const std::pair<const char*, meshlife::LeniaBackend> backends[] = {
+        {"scalar", meshlife::LeniaBackend::Scalar},
+        {"avx2", meshlife::LeniaBackend::AVX2},
+        {"avx512", meshlife::LeniaBackend::AVX512},
+        {"eigen", meshlife::LeniaBackend::Eigen},
+    };
+
+    std::vector<Benchmark> benchmarks;
+    for (const MeshCase& c : mesh_cases())
+    {
+        // meshes are generated lazily, on first use by a benchmark that passed the filter
+        auto mesh = std::make_shared<pmp::SurfaceMesh>();
+        auto get_mesh = [mesh, generate = c.generate]() -> pmp::SurfaceMesh& {
+            if (mesh->is_empty())
+            {
+                *mesh = generate();
+                meshlife::helpers::reorder_faces_spatially(*mesh);
+            }
+            return *mesh;
+        };
+
+        if (!c.closed)
+        {
+            benchmarks.push_back({"lenia_precache/euclidean/" + c.name, mesh, [=] {
+                                      std::shared_ptr<meshlife::MeshLenia> lenia
+                                          = make_lenia(get_mesh(), meshlife::LeniaBackend::Auto);
+                                      return [lenia] { lenia->precache_face_values(); };
+                                  }});
+            continue;
+        }
+
+        for (bool bit_packed : {true, false})
+        {
+            benchmarks.push_back({std::string("gol_update/") + (bit_packed ? "bit_packed/" : "gather/") + c.name,
+                                  mesh, [=] {
+                                      auto gol = std::make_shared<meshlife::MeshGOL>(get_mesh());
+                                      gol->p_bit_packed_ = bit_packed;
+                                      srand(0);
+                                      gol->init_state_random();
+                                      return [gol] { gol->update_state(1); };
+                                  }});
+        }
+
+        for (const auto& [backend_name, backend] : backends)
+        {
+            if (!meshlife::simd::is_supported(backend))
+                continue;
+            benchmarks.push_back({std::string("lenia_update/") + backend_name + "/" + c.name, mesh, [=] {
+                                      std::shared_ptr<meshlife::MeshLenia> lenia = make_lenia(get_mesh(), backend);
+                                      return [lenia] { lenia->update_state(1); };
+                                  }});
+        }
+
+        for (size_t n_parameters : {1, 4, 16})
+        {
+            // a parameter sweep of meshlife_sim, one step of all lanes per iteration
+            benchmarks.push_back({"lenia_batch/" + std::to_string(n_parameters) + "/" + c.name, mesh, [=] {
+                                      std::shared_ptr<meshlife::MeshLenia> lenia
+                                          = make_lenia(get_mesh(), meshlife::LeniaBackend::Scalar);
+                                      std::vector<meshlife::LeniaParameters> parameters(n_parameters);
+                                      for (size_t i = 0; i < n_parameters; i++)
+                                          parameters[i].mu += 0.01f * i;
+                                      auto batch = std::make_shared<meshlife::MeshLeniaBatch>(*lenia, parameters);
+                                      batch->init_state_random();
+                                      // the batch refers to the kernel of lenia
+                                      return [lenia, batch] { batch->update_state(1); };
+                                  }});
+        }
+
+        benchmarks.push_back({"lenia_precache/geodesic/" + c.name, mesh, [=] {
+                                  std::shared_ptr<meshlife::MeshLenia> lenia
+                                      = make_lenia(get_mesh(), meshlife::LeniaBackend::Auto);
+                                  return [lenia] { lenia->precache_face_values(); };
+                              }});
+
+        // weight stage only, as after changing the beta peaks
+        benchmarks.push_back({"lenia_kernel/" + c.name, mesh, [=] {
+                                  std::shared_ptr<meshlife::MeshLenia> lenia
+                                      = make_lenia(get_mesh(), meshlife::LeniaBackend::Auto);
+                                  return [lenia] { lenia->kernel_precompute(); };
+                              }});
+
+        for (bool face_colors : {true, false})
+        {
+            // with face colors every triangle needs its own vertices, without the smooth shaded vertices are shared
+            benchmarks.push_back({std::string("buffer_build/") + (face_colors ? "face_colors/" : "indexed/") + c.name,
+                                  mesh, [=] {
+                                      auto m = std::make_shared<pmp::SurfaceMesh>(get_mesh());
+                                      if (face_colors)
+                                      {
+                                          auto colors = m->face_property<pmp::Color>("f:color");
+                                          for (auto f : m->faces())
+                                              colors[f] = pmp::Color(f.idx() % 2, 0.5, 0.5);
+                                      }
+                                      auto buffers = std::make_shared<meshlife::MeshBuffers>();
+                                      return [buffers, m] { buffers->build(*m, 180, true); };
+                                  }});
+        }
+
+        benchmarks.push_back({"buffer_build/crease_angle/" + c.name, mesh, [=] {
+                                  // per corner normals, smoothed only over edges with a dihedral angle below 60 degrees
+                                  auto m = std::make_shared<pmp::SurfaceMesh>(get_mesh());
+                                  auto buffers = std::make_shared<meshlife::MeshBuffers>();
+                                  return [buffers, m] { buffers->build(*m, 60, true); };
+                              }});
+
+        benchmarks.push_back({"buffer_build/tessellate/" + c.name, mesh, [=] {
+                                  // like a rebuild after an edit of the geometry, without the cached tessellation
+                                  auto m = std::make_shared<pmp::SurfaceMesh>(get_mesh());
+                                  auto buffers = std::make_shared<meshlife::MeshBuffers>();
+                                  return [buffers, m] {
+                                      buffers->invalidate_geometry();
+                                      buffers->build(*m, 180, true);
+                                  };
+                              }});
+
+        benchmarks.push_back({"find_face/cpu_fallback/" + c.name, mesh, [=] {
+                                  // the viewer's picking without its face index pass, which can not run here.
+                                  // Points on the bounding box diagonals, cycled through
+                                  pmp::SurfaceMesh& m = get_mesh();
+                                  pmp::BoundingBox bb = pmp::bounds(m);
+                                  auto points = std::make_shared<std::vector<pmp::Point>>();
+                                  for (int i = 0; i < 64; i++)
+                                  {
+                                      const pmp::Scalar t = (i + 0.5) / 64;
+                                      points->push_back(bb.min() + t * (bb.max() - bb.min()));
+                                  }
+                                  auto next = std::make_shared<size_t>(0);
+                                  return [points, next, &m] {
+                                      pmp::Face f = meshlife::helpers::nearest_face(m, (*points)[(*next)++ % 64]);
+                                      if (!f.is_valid())
+                                          std::cerr << "Error: find_face/cpu_fallback found no face" << std::endl;
+                                  };
+                              }});
+    }
+    return benchmarks;
+}
+
+/// Runs \p body with increasing iteration counts until one run takes at least \p min_time seconds
+Result run(const std::string& name, const std::function<void()>& body, double min_time, size_t faces)
+{
+    MuteStdout mute;
+
+    // warm up caches and lazily built data
+    body();
+
+    size_t iterations = 1;
+    while (true)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const std::clock_t cpu_start = std::clock();
+        for (size_t i = 0; i < iterations; i++)
+            body();
+        const double cpu = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        const double real = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (real >= min_time || iterations >= 1000000000)
+            return {name, iterations, real / iterations * 1e6, cpu / iterations * 1e6, faces};
+
+        // same growth rule as Google Benchmark, at most 10x per round
+        const double multiplier = std::min(10.0, min_time * 1.4 / std::max(real, 1e-9));
+        iterations = std::max(iterations + 1, size_t(iterations * multiplier));
+    }
+}
+
+void print_console_header()
+{
+    printf("%-48s %14s %14s %12s %14s\n", "Benchmark", "Time", "CPU", "Iterations", "faces/s");
+    printf("%s\n", std::string(106, '-').c_str());
+}
+
+void print_console(const Result& r)
+{
+    printf("%-48s %11.1f us %11.1f us %12zu %13.4gM\n",
+           r.name.c_str(),
+           r.real_time,
+           r.cpu_time,
+           r.iterations,
+           r.faces / r.real_time);
+    fflush(stdout);
+}
+
+void write_json(std::ostream& out, const std::vector<Result>& results, const char* executable)
+{
+    char date[64];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+#ifdef _OPENMP
+    const int threads = omp_get_max_threads();
+#else
+    const int threads = 1;
+#endif
+#ifdef NDEBUG
+    const char* build_type = "release";
+#else
+    const char* build_type = "debug";
+#endif
+
+    out << "{\n"
+        << "  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"host_name\": \"" << host << "\",\n"
+        << "    \"executable\": \"" << executable << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"omp_threads\": " << threads << ",\n"
+        << "    \"lenia_auto_backend\": \""
+        << meshlife::simd::backend_name(meshlife::simd::resolve(meshlife::LeniaBackend::Auto)) << "\",\n"
+        << "    \"library_build_type\": \"" << build_type << "\"\n"
+        << "  },\n"
+        << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        out << (i ? "," : "") << "\n    {\n"
+            << "      \"name\": \"" << r.name << "\",\n"
+            << "      \"run_name\": \"" << r.name << "\",\n"
+            << "      \"run_type\": \"iteration\",\n"
+            << "      \"repetitions\": 1,\n"
+            << "      \"repetition_index\": 0,\n"
+            << "      \"threads\": 1,\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"real_time\": " << r.real_time << ",\n"
+            << "      \"cpu_time\": " << r.cpu_time << ",\n"
+            << "      \"time_unit\": \"us\",\n"
+            << "      \"faces\": " << r.faces << ",\n"
+            << "      \"items_per_second\": " << r.faces / r.real_time * 1e6 << "\n"
+            << "    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        std::string value;
+        if (arg == "-h" || arg == "--help")
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--benchmark_list_tests" || arg == "--benchmark_list_tests=true")
+            options.list = true;
+        else if (parse_flag(arg, "benchmark_filter", value))
+            options.filter = value;
+        else if (parse_flag(arg, "benchmark_min_time", value))
+            options.min_time = std::atof(value.c_str()); // a trailing 's' as in "0.5s" is ignored
+        else if (parse_flag(arg, "benchmark_out", value))
+            options.out = value;
+        else if (parse_flag(arg, "benchmark_format", value) && (value == "console" || value == "json"))
+            options.format = value;
+        else
+        {
+            std::cerr << "Error: Unknown argument " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::regex filter;
+    try
+    {
+        filter = std::regex(options.filter);
+    }
+    catch (const std::regex_error& e)
+    {
+        std::cerr << "Error: Invalid filter " << options.filter << " (" << e.what() << ")" << std::endl;
+        return 1;
+    }
+
+    std::vector<Benchmark> benchmarks;
+    for (Benchmark& b : register_benchmarks())
+    {
+        if (std::regex_search(b.name, filter))
+            benchmarks.push_back(std::move(b));
+    }
+
+    if (options.list)
+    {
+        for (const Benchmark& b : benchmarks)
+            std::cout << b.name << "\n";
+        return 0;
+    }
+
+    const bool console = options.format == "console";
+    if (console)
+        print_console_header();
+
+    std::vector<Result> results;
+    for (const Benchmark& b : benchmarks)
+    {
+        const std::function<void()> body = b.setup();
+        results.push_back(run(b.name, body, options.min_time, b.mesh->n_faces()));
+        if (console)
+            print_console(results.back());
+    }
+
+    if (!console)
+        write_json(std::cout, results, argv[0]);
+    if (!options.out.empty())
+    {
+        std::ofstream file(options.out);
+        write_json(file, results, argv[0]);
+        if (!file)
+        {
+            std::cerr << "Error: Could not write " << options.out << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
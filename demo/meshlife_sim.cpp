@@ -0,0 +1,511 @@
+#include "meshlife/algorithms/helpers.h"
+#include "meshlife/algorithms/mesh_gol.h"
+#include "meshlife/algorithms/mesh_lenia.h"
+#include "meshlife/algorithms/mesh_lenia_batch.h"
+#include "meshlife/trajectory.h"
+#include <pmp/algorithms/shapes.h>
+#include <pmp/io/io.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// Settings of a headless run, set with key=value pairs on the command line or in a config file
+struct Config
+{
+    std::string mesh = "quad_sphere:5";
+    std::string automaton = "gol";
+    int steps = 100;
+    int snapshot_every = 0;
+    std::string output = "sim_output";
+    unsigned int seed = 0;
+    bool reorder = true;
+    std::string trajectory;
+    std::string trajectory_encoding = "float";
+    bool trajectory_compress = true;
+    bool neighborhood_cache = true;
+
+    // Game of Life
+    int lower = 2;
+    int upper = 3;
+
+    // Lenia, comma separated lists of mu, sigma and T run all their combinations side by side
+    std::string mu = "0.581";
+    std::string sigma = "0.131";
+    std::string T = "10";
+    float radius = 8;
+    std::string peaks = "1,0.333333";
+    std::string backend = "auto";
+};
+
+void print_usage(const char* name)
+{
+    std::cout << "Usage: " << name << " [config file] [key=value ...]\n"
+              << "Runs a simulation without a window and writes the states as raw float32 arrays (one value per face\n"
+              << "in face index order) to <output>/state_<step>.raw, the mesh in that face order to <output>/mesh.obj.\n"
+              << "Config files contain one key=value pair per line, '#' starts a comment. Later values win.\n\n"
+              << "Keys (default):\n"
+              << "  mesh            mesh file or quad_sphere:N, icosphere:N, plane:N (quad_sphere:5)\n"
+              << "  automaton       gol or lenia (gol)\n"
+              << "  steps           number of steps (100)\n"
+              << "  snapshot_every  write a snapshot every N steps, 0 only writes the first and last state (0)\n"
+              << "  output          output directory (sim_output)\n"
+              << "  seed            seed of the random initial state (0)\n"
+              << "  reorder         sort faces spatially for faster steps, true or false (true)\n"
+              << "  trajectory      also write every step to this trajectory file, viewable in the viewer ()\n"
+              << "  trajectory_encoding  state per face in the trajectory: float, uint8 or bits (float)\n"
+              << "  trajectory_compress  store the trajectory as run length encoded deltas, true or false (true)\n"
+              << "  neighborhood_cache  reuse the Lenia neighborhoods from a cache file next to the mesh file (or in\n"
+              << "                  the output directory for generated meshes), true or false (true)\n"
+              << "  lower, upper    GOL survival/birth thresholds (2, 3)\n"
+              << "  mu, sigma, T    Lenia growth parameters (0.581, 0.131, 10). Comma separated lists sweep over all\n"
+              << "                  combinations in one batch, which writes the states of combination L to\n"
+              << "                  <output>/lane_L and lists the combinations in <output>/sweep.txt\n"
+              << "  radius          Lenia neighborhood radius in mean edge lengths (8)\n"
+              << "  peaks           Lenia kernel peaks, comma separated (1,0.333333)\n"
+              << "  backend         Lenia backend: auto, scalar, avx2, avx512, eigen (auto)\n";
+}
+
+std::string trim(const std::string& s)
+{
+    const size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+        return "";
+    const size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+bool parse_bool(const std::string& value)
+{
+    if (value == "true" || value == "1" || value == "on")
+        return true;
+    if (value == "false" || value == "0" || value == "off")
+        return false;
+    throw std::invalid_argument("expected true or false");
+}
+
+meshlife::LeniaBackend parse_backend(const std::string& name)
+{
+    if (name == "auto")
+        return meshlife::LeniaBackend::Auto;
+    if (name == "scalar")
+        return meshlife::LeniaBackend::Scalar;
+    if (name == "avx2")
+        return meshlife::LeniaBackend::AVX2;
+    if (name == "avx512")
+        return meshlife::LeniaBackend::AVX512;
+    if (name == "eigen")
+        return meshlife::LeniaBackend::Eigen;
+    throw std::invalid_argument("unknown backend");
+}
+
+meshlife::TrajectoryEncoding parse_trajectory_encoding(const std::string& name)
+{
+    if (name == "float")
+        return meshlife::TrajectoryEncoding::Float32;
+    if (name == "uint8")
+        return meshlife::TrajectoryEncoding::UInt8;
+    if (name == "bits")
+        return meshlife::TrajectoryEncoding::Bits;
+    throw std::invalid_argument("unknown trajectory encoding");
+}
+
+float to_float(const std::string& value)
+{
+    return std::stof(value);
+}
+
+float to_finite_float(const std::string& value)
+{
+    const float f = std::stof(value);
+    if (!std::isfinite(f))
+        throw std::invalid_argument("not finite");
+    return f;
+}
+
+int to_int(const std::string& value)
+{
+    return std::stoi(value);
+}
+
+/// Converts every item of the comma separated list \p value with \p convert, throws std::invalid_argument if an item
+/// is malformed or the list is empty
+template <typename Convert>
+auto parse_list(const std::string& value, Convert convert)
+{
+    std::vector<decltype(convert(value))> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        items.push_back(convert(trim(item)));
+    if (items.empty())
+        throw std::invalid_argument("empty list");
+    return items;
+}
+
+/// All combinations of the Lenia growth parameters in \p config, T varies fastest
+std::vector<meshlife::LeniaParameters> lenia_parameters(const Config& config)
+{
+    std::vector<meshlife::LeniaParameters> parameters;
+    for (float mu : parse_list(config.mu, to_float))
+        for (float sigma : parse_list(config.sigma, to_float))
+            for (int T : parse_list(config.T, to_int))
+                parameters.push_back({mu, sigma, T});
+    return parameters;
+}
+
+/// Sets \p key of \p config, throws std::invalid_argument for unknown keys or malformed values
+void set_option(Config& config, const std::string& key, const std::string& value)
+{
+    if (key == "mesh")
+        config.mesh = value;
+    else if (key == "automaton")
+        config.automaton = value;
+    else if (key == "steps")
+        config.steps = std::stoi(value);
+    else if (key == "snapshot_every")
+        config.snapshot_every = std::stoi(value);
+    else if (key == "output")
+        config.output = value;
+    else if (key == "seed")
+        config.seed = std::stoul(value);
+    else if (key == "reorder")
+        config.reorder = parse_bool(value);
+    else if (key == "trajectory")
+        config.trajectory = value;
+    else if (key == "trajectory_encoding")
+    {
+        parse_trajectory_encoding(value);
+        config.trajectory_encoding = value;
+    }
+    else if (key == "trajectory_compress")
+        config.trajectory_compress = parse_bool(value);
+    else if (key == "neighborhood_cache")
+        config.neighborhood_cache = parse_bool(value);
+    else if (key == "lower")
+        config.lower = std::stoi(value);
+    else if (key == "upper")
+        config.upper = std::stoi(value);
+    else if (key == "mu")
+    {
+        parse_list(value, to_float);
+        config.mu = value;
+    }
+    else if (key == "sigma")
+    {
+        parse_list(value, to_float);
+        config.sigma = value;
+    }
+    else if (key == "T")
+    {
+        parse_list(value, to_int);
+        config.T = value;
+    }
+    else if (key == "radius")
+        config.radius = std::stof(value);
+    else if (key == "peaks")
+    {
+        parse_list(value, to_finite_float);
+        config.peaks = value;
+    }
+    else if (key == "backend")
+    {
+        // validate now, so typos are reported before the precomputation
+        parse_backend(value);
+        config.backend = value;
+    }
+    else
+        throw std::invalid_argument("unknown key");
+}
+
+/// Parses "key=value" (a leading "--" is ignored), returns false if \p line is no such pair
+bool parse_option(Config& config, std::string line, const std::string& origin)
+{
+    if (line.rfind("--", 0) == 0)
+        line = line.substr(2);
+    const size_t eq = line.find('=');
+    if (eq == std::string::npos)
+        return false;
+
+    const std::string key = trim(line.substr(0, eq));
+    const std::string value = trim(line.substr(eq + 1));
+    try
+    {
+        set_option(config, key, value);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << origin << ": invalid option '" << key << "=" << value << "' (" << e.what() << ")"
+                  << std::endl;
+        exit(1);
+    }
+    return true;
+}
+
+void read_config_file(Config& config, const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Error: Can not open config file " << path << std::endl;
+        exit(1);
+    }
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line))
+    {
+        line_number++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+        if (!parse_option(config, line, path + ":" + std::to_string(line_number)))
+        {
+            std::cerr << "Error: " << path << ":" << line_number << ": expected key=value" << std::endl;
+            exit(1);
+        }
+    }
+}
+
+pmp::SurfaceMesh load_mesh(const std::string& description)
+{
+    const size_t colon = description.find(':');
+    if (colon != std::string::npos && !std::filesystem::exists(description))
+    {
+        const std::string shape = description.substr(0, colon);
+        const int level = std::stoi(description.substr(colon + 1));
+        if (shape == "quad_sphere")
+            return pmp::quad_sphere(level);
+        if (shape == "icosphere")
+            return pmp::icosphere(level);
+        if (shape == "plane")
+            return pmp::plane(level);
+    }
+
+    pmp::SurfaceMesh mesh;
+    pmp::read(mesh, description);
+    return mesh;
+}
+
+void write_snapshot(const std::filesystem::path& directory, const float* state, size_t n_faces, int step)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "state_%06d.raw", step);
+    std::ofstream file(directory / name, std::ios::binary);
+    file.write((const char*)state, n_faces * sizeof(float));
+    if (!file)
+    {
+        std::cerr << "Error: Could not write snapshot " << name << std::endl;
+        exit(1);
+    }
+}
+
+/// Evolves one state per entry of \p parameters side by side in a MeshLeniaBatch over the kernel of \p lenia, all
+/// starting from the state of \p lenia. Writes the snapshots like a single run, but per lane.
+int run_sweep(const Config& config, pmp::SurfaceMesh& mesh, const meshlife::MeshLenia& lenia,
+              const std::vector<meshlife::LeniaParameters>& parameters)
+{
+    meshlife::MeshLeniaBatch batch(lenia, parameters);
+    auto lane_directory = [&](size_t lane) {
+        return std::filesystem::path(config.output) / ("lane_" + std::to_string(lane));
+    };
+
+    std::ofstream table(std::filesystem::path(config.output) / "sweep.txt");
+    table << "# lane mu sigma T\n";
+    for (size_t lane = 0; lane < batch.lanes(); lane++)
+    {
+        batch.set_state(lane, lenia.state_prop());
+        table << lane << " " << parameters[lane].mu << " " << parameters[lane].sigma << " " << parameters[lane].T
+              << "\n";
+        std::filesystem::create_directories(lane_directory(lane));
+    }
+    table.close();
+    if (!table)
+    {
+        std::cerr << "Error: Could not write " << std::filesystem::path(config.output) / "sweep.txt" << std::endl;
+        return 1;
+    }
+
+    auto lane_state = mesh.add_face_property<float>("f:sweep_state");
+    auto write_lanes = [&](int step) {
+        for (size_t lane = 0; lane < batch.lanes(); lane++)
+        {
+            batch.get_state(lane, lane_state);
+            write_snapshot(lane_directory(lane), lane_state.data(), mesh.faces_size(), step);
+        }
+    };
+    write_lanes(0);
+
+    double simulation_seconds = 0;
+    int step = 0;
+    while (step < config.steps)
+    {
+        const int n = config.snapshot_every > 0 ? std::min(config.snapshot_every, config.steps - step)
+                                                : config.steps - step;
+        const auto start = std::chrono::steady_clock::now();
+        batch.update_state(n);
+        simulation_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        step += n;
+        if (config.snapshot_every > 0 ? step % config.snapshot_every == 0 || step == config.steps
+                                      : step == config.steps)
+            write_lanes(step);
+    }
+    mesh.remove_face_property(lane_state);
+
+    std::cout << "Done: " << config.steps << " steps of " << batch.lanes() << " lanes in " << simulation_seconds
+              << " s (" << config.steps / std::max(simulation_seconds, 1e-9) << " steps/s)" << std::endl;
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Config config;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (!parse_option(config, arg, "command line"))
+            read_config_file(config, arg);
+    }
+
+    pmp::SurfaceMesh mesh;
+    try
+    {
+        mesh = load_mesh(config.mesh);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: Can not load mesh " << config.mesh << " (" << e.what() << ")" << std::endl;
+        return 1;
+    }
+    if (config.reorder)
+        meshlife::helpers::reorder_faces_spatially(mesh);
+    else
+        mesh.garbage_collection();
+
+    std::filesystem::create_directories(config.output);
+    pmp::write(mesh, std::filesystem::path(config.output) / "mesh.obj");
+
+    std::unique_ptr<meshlife::MeshAutomaton> automaton;
+    const std::vector<meshlife::LeniaParameters> growth = lenia_parameters(config);
+    const meshlife::MeshLenia* sweep_lenia = nullptr;
+    if (growth.size() > 1 && (config.automaton != "lenia" || !config.trajectory.empty()))
+    {
+        std::cerr << "Error: Lists of mu, sigma and T are only supported for lenia without a trajectory" << std::endl;
+        return 1;
+    }
+
+    if (config.automaton == "gol")
+    {
+        auto gol = std::make_unique<meshlife::MeshGOL>(mesh);
+        gol->p_lower_threshold_ = config.lower;
+        gol->p_upper_threshold_ = config.upper;
+        automaton = std::move(gol);
+    }
+    else if (config.automaton == "lenia")
+    {
+        auto lenia = std::make_unique<meshlife::MeshLenia>(mesh, false);
+        lenia->p_mu_ = growth[0].mu;
+        lenia->p_sigma_ = growth[0].sigma;
+        lenia->p_T_ = growth[0].T;
+        lenia->p_neighborhood_radius_ = config.radius * lenia->average_edge_length_;
+        lenia->p_backend_ = parse_backend(config.backend);
+        lenia->p_beta_peaks_ = parse_list(config.peaks, to_finite_float);
+        if (config.neighborhood_cache)
+        {
+            if (std::filesystem::exists(config.mesh))
+                lenia->p_neighborhood_cache_ = config.mesh;
+            else
+            {
+                std::string name = config.mesh;
+                std::replace(name.begin(), name.end(), ':', '_');
+                lenia->p_neighborhood_cache_ = std::filesystem::path(config.output) / name;
+            }
+        }
+        lenia->allocate_needed_properties();
+        if (growth.size() > 1)
+            sweep_lenia = lenia.get();
+        automaton = std::move(lenia);
+    }
+    else
+    {
+        std::cerr << "Error: Unknown automaton " << config.automaton << " (gol or lenia)" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Running " << config.automaton << " on " << config.mesh << " (" << mesh.n_faces() << " faces) for "
+              << config.steps << " steps";
+    if (sweep_lenia)
+        std::cout << " with " << growth.size() << " parameter combinations";
+    std::cout << std::endl;
+
+    srand(config.seed);
+    automaton->init_state_random();
+    if (sweep_lenia)
+        return run_sweep(config, mesh, *sweep_lenia, growth);
+    write_snapshot(config.output, automaton->state_prop().data(), mesh.faces_size(), 0);
+
+    meshlife::TrajectoryWriter trajectory;
+    if (!config.trajectory.empty())
+    {
+        // the parameters of the run, so a trajectory can be reproduced
+        std::stringstream parameters;
+        parameters << "mesh=" << config.mesh << "\nautomaton=" << config.automaton << "\nseed=" << config.seed
+                   << "\nreorder=" << config.reorder << "\nlower=" << config.lower << "\nupper=" << config.upper
+                   << "\nmu=" << config.mu << "\nsigma=" << config.sigma << "\nT=" << config.T
+                   << "\nradius=" << config.radius << "\npeaks=" << config.peaks << "\n";
+        if (!trajectory.open(config.trajectory, mesh, parse_trajectory_encoding(config.trajectory_encoding),
+                             config.trajectory_compress ? meshlife::TrajectoryCompression::DeltaRLE
+                                                        : meshlife::TrajectoryCompression::None,
+                             parameters.str())
+            || !trajectory.write(0, automaton->state_prop().data()))
+            return 1;
+    }
+
+    double simulation_seconds = 0;
+    int step = 0;
+    while (step < config.steps)
+    {
+        int n = config.snapshot_every > 0 ? std::min(config.snapshot_every, config.steps - step)
+                                          : config.steps - step;
+        // the trajectory needs every step
+        if (trajectory.is_open())
+            n = 1;
+        const auto start = std::chrono::steady_clock::now();
+        automaton->update_state(n);
+        simulation_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        step += n;
+        if (trajectory.is_open() && !trajectory.write(step, automaton->state_prop().data()))
+            return 1;
+        if (config.snapshot_every > 0 ? step % config.snapshot_every == 0 || step == config.steps
+                                      : step == config.steps)
+            write_snapshot(config.output, automaton->state_prop().data(), mesh.faces_size(), step);
+    }
+    if (trajectory.is_open())
+    {
+        std::cout << "Wrote " << trajectory.frames_written() << " frames (" << trajectory.bytes_written()
+                  << " bytes) to " << config.trajectory << std::endl;
+        trajectory.close();
+    }
+
+    std::cout << "Done: " << config.steps << " steps in " << simulation_seconds << " s ("
+              << config.steps / std::max(simulation_seconds, 1e-9) << " steps/s)" << std::endl;
+    return 0;
+}
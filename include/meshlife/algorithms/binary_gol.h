@@ -0,0 +1,78 @@
+#pragma once
+
+#include <meshlife/algorithms/helpers.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace meshlife
+{
+
+/// Game of life on binary face states stored as bitsets, 64 faces per word.
+/// Meshes with at most MAX_SLOTS neighbors per face (quad meshes have 8, most triangle meshes 12) store the neighbors
+/// in fixed slots per face and count all 64 faces of a word at once with a bit-sliced adder. If slot k of all faces of
+/// a word has the same index offset (rows of regular grids), its 64 neighbor bits are one shifted read of the bitset,
+/// otherwise they are gathered bit by bit. Meshes where less than half of the slots can be shifted (and meshes with
+/// more neighbors) gather the neighbor bits along the adjacency table and count per face.
+class BinaryGOL
+{
+  public:
+    static constexpr int MAX_SLOTS = 15;
+
+    /// Prepares the engine for \p adjacency, which must stay alive (and unchanged) while the engine is used
+    void build(const helpers::FaceAdjacency& adjacency);
+
+    /// Number of faces
+    inline size_t size() const
+    {
+        return n_faces_;
+    }
+
+    /// Whether the word parallel (slot) path is used
+    inline bool uses_slots() const
+    {
+        return n_slots_ > 0;
+    }
+
+    /// Fraction of word slots that are read with a shift instead of a gather
+    double shifted_slot_ratio() const;
+
+    /// Packs the float states (alive is 1, dead is 0), returns false if any state is neither 0 nor 1
+    bool pack(const float* state);
+
+    /// Writes the states as floats
+    void unpack(float* state) const;
+
+    inline bool alive(size_t f) const
+    {
+        return (bits_[f >> 6] >> (f & 63)) & 1;
+    }
+
+    /// Computes \p num_steps timesteps, a living cell survives with \p lower to \p upper alive neighbors and a dead cell
+    /// is born with exactly \p upper alive neighbors
+    void step(int num_steps, int lower, int upper);
+
+  private:
+    void step_slots(uint64_t in_range_counts, uint64_t born_counts);
+    void step_gather(int lower, int upper);
+
+    const helpers::FaceAdjacency* adjacency_ = nullptr;
+    size_t n_faces_ = 0;
+    size_t n_words_ = 0;
+
+    /// neighbors of face f are slots_[f * n_slots_] ... slots_[f * n_slots_ + n_slots_ - 1], unused slots point to
+    /// face n_faces_ whose bit is always 0
+    int n_slots_ = 0;
+    std::vector<uint32_t> slots_;
+
+    /// index offset of slot k shared by all faces of word w at word_offsets_[w * n_slots_ + k], or GATHER
+    static constexpr int32_t GATHER = INT32_MIN;
+    /// slot k is unused by all faces of the word
+    static constexpr int32_t EMPTY = INT32_MAX;
+    std::vector<int32_t> word_offsets_;
+
+    std::vector<uint64_t> bits_;
+    std::vector<uint64_t> next_bits_;
+};
+
+} // namespace meshlife
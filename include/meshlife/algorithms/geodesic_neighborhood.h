@@ -0,0 +1,78 @@
+#pragma once
+
+#include <pmp/surface_mesh.h>
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace meshlife
+{
+
+/// Radius bounded geodesic distances from seed vertices, computed on a shared read-only mesh.
+///
+/// Uses the same fast marching scheme (Kimmel updates with virtual edges through obtuse angles) as
+/// pmp::geodesics(), so distances are identical, but the mesh is never copied or modified: virtual edges are
+/// computed once and all per-query data lives in a Scratch object. Every thread needs its own Scratch, the
+/// GeodesicNeighborhood itself can be shared between threads.
+class GeodesicNeighborhood
+{
+  public:
+    /// Per-thread working memory. Only the entries touched by a query get reset afterwards, so the cost of a
+    /// query depends on the size of the neighborhood and not on the size of the mesh.
+    struct Scratch
+    {
+        std::vector<pmp::Scalar> distance;
+        std::vector<bool> processed;
+        std::vector<uint32_t> touched;
+        std::vector<std::pair<pmp::Scalar, uint32_t>> front;
+    };
+
+    /// (vertex, geodesic distance) pairs in the order the front reached them
+    typedef std::vector<std::pair<pmp::Vertex, pmp::Scalar>> Neighbors;
+
+    /// Precomputes the virtual edges of \p mesh. The mesh must outlive this object and must not change.
+    explicit GeodesicNeighborhood(const pmp::SurfaceMesh& mesh);
+
+    /// Creates scratch memory fitting the mesh
+    Scratch make_scratch() const;
+
+    /// Computes all vertices up to geodesic distance \p maxdist from \p seeds (the seeds are not included).
+    /// Like pmp::geodesics() the direct one-ring of the seeds is always returned, even beyond \p maxdist.
+    void compute(const std::vector<pmp::Vertex>& seeds,
+                 pmp::Scalar maxdist,
+                 Scratch& scratch,
+                 Neighbors& neighbors) const;
+
+  private:
+    struct VirtualEdge
+    {
+        pmp::Vertex vertex;
+        pmp::Scalar length = 0;
+    };
+
+    void find_virtual_edges();
+
+    void heap_vertex(pmp::Vertex v, Scratch& scratch) const;
+
+    pmp::Scalar distance(const Scratch& scratch,
+                         pmp::Vertex v0,
+                         pmp::Vertex v1,
+                         pmp::Vertex v2,
+                         pmp::Scalar r0 = std::numeric_limits<pmp::Scalar>::max(),
+                         pmp::Scalar r1 = std::numeric_limits<pmp::Scalar>::max()) const;
+
+    inline void touch(pmp::Vertex v, Scratch& scratch) const
+    {
+        if (!scratch.processed[v.idx()] && scratch.distance[v.idx()] == std::numeric_limits<pmp::Scalar>::max())
+            scratch.touched.push_back(v.idx());
+    }
+
+    const pmp::SurfaceMesh& mesh_;
+
+    /// Virtual edge per halfedge, invalid vertex if the halfedge has none
+    std::vector<VirtualEdge> virtual_edges_;
+};
+
+} // namespace meshlife
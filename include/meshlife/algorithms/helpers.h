@@ -1,7 +1,9 @@
 #pragma once
 
 #include <pmp/surface_mesh.h>
+#include <cstdint>
 #include <set>
+#include <vector>
 
 namespace meshlife
 {
@@ -12,6 +14,87 @@ namespace helpers
 /// Returns a set of neigbored faces of face f
 std::set<pmp::Face> get_neighbored_faces(pmp::SurfaceMesh& mesh, pmp::Face f);
 
+/// Face neighborhoods (faces sharing at least one vertex) stored in compressed sparse row format.
+/// The neighbors of the face with index i are indices[offsets[i]] ... indices[offsets[i + 1] - 1]
+struct FaceAdjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> indices;
+
+    /// Number of faces (rows) the table was built for
+    inline size_t size() const
+    {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    inline void clear()
+    {
+        offsets.clear();
+        indices.clear();
+    }
+};
+
+/// Builds the adjacency table of all faces of \p mesh, rows are indexed by face.idx().
+/// Contains the same neighbors as get_neighbored_faces(), deleted faces get an empty row.
+FaceAdjacency build_face_adjacency(const pmp::SurfaceMesh& mesh);
+
+/// Snapshot of the element counts of a mesh, used to detect when precomputed topology data got stale
+struct TopologyFingerprint
+{
+    size_t vertices_size = 0;
+    size_t halfedges_size = 0;
+    size_t faces_size = 0;
+    size_t n_faces = 0;
+    /// revision of the face order set by the last permute_faces() on the mesh, renumbered faces keep all counts
+    uint32_t face_order = 0;
+
+    bool operator==(const TopologyFingerprint& other) const
+    {
+        return vertices_size == other.vertices_size && halfedges_size == other.halfedges_size
+               && faces_size == other.faces_size && n_faces == other.n_faces && face_order == other.face_order;
+    }
+
+    bool operator!=(const TopologyFingerprint& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/// Returns the current topology fingerprint of \p mesh
+TopologyFingerprint topology_fingerprint(const pmp::SurfaceMesh& mesh);
+
+/// Start value of the 64 bit FNV-1a hashes below
+constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+/// Continues the 64 bit FNV-1a hash \p hash with \p size bytes at \p data
+uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = HASH_SEED);
+
+/// 64 bit FNV-1a hash of the face indices and the vertex indices of every face, equal for meshes whose faces have the
+/// same index and corners. Identifies data stored per face index across runs.
+uint64_t connectivity_hash(const pmp::SurfaceMesh& mesh);
+
+/// 64 bit FNV-1a hash of the connectivity and the exact vertex positions, identifies data that depends on the shape
+uint64_t geometry_hash(const pmp::SurfaceMesh& mesh);
+
+/// Returns the face of \p mesh whose centroid is closest to \p p, invalid if the mesh has no faces.
+/// The viewer picks faces with this when its face index pass is unavailable.
+pmp::Face nearest_face(const pmp::SurfaceMesh& mesh, const pmp::Point& p);
+
+/// Returns the face indices of \p mesh sorted along a Morton (Z-order) curve over the face centroids.
+/// Deleted faces are skipped, so the result only covers the whole mesh after garbage collection.
+std::vector<uint32_t> morton_face_order(const pmp::SurfaceMesh& mesh);
+
+/// Renumbers the faces of \p mesh such that the new face i is the old face order[i].
+/// Connectivity and face properties of the common value types (including the automaton state) are permuted along.
+/// Returns false and leaves the mesh untouched if \p order is no permutation of all faces or a face property of
+/// another type exists. Data cached by face index (e.g. automaton neighborhoods) has to be rebuilt afterwards, the
+/// topology fingerprint of \p mesh changes to make that detectable (stored in the face property "f:face_order").
+bool permute_faces(pmp::SurfaceMesh& mesh, const std::vector<uint32_t>& order);
+
+/// Garbage collects \p mesh and sorts its faces by morton_face_order() so that faces close in space are close in
+/// memory, which makes neighbor gathers of the automatons mostly cache hits
+bool reorder_faces_spatially(pmp::SurfaceMesh& mesh);
+
 } // namespace helpers
 
 } // namespace meshlife
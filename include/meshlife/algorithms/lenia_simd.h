@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace meshlife
+{
+
+/// Implementation used to evaluate the Lenia convolution
+enum class LeniaBackend
+{
+    Auto,   ///< AVX2 if the CPU supports it, otherwise Scalar
+    Scalar, ///< Plain loop, same summation order as MeshLenia::merged_together()
+    AVX2,   ///< 8 wide gathers + FMA
+    AVX512, ///< 16 wide gathers + FMA, only on request: slower than AVX2 at the usual neighborhood sizes
+    Eigen,  ///< One multithreaded sparse matrix vector product per step (MeshLenia::kernel_matrix())
+    COUNT
+};
+
+namespace simd
+{
+
+/// Computes the weighted sum of \p n gathered values state[indices[j]] * weights[j]
+typedef float (*RowFunction)(const uint32_t* indices, const float* weights, size_t n, const float* state);
+
+/// Returns whether \p backend can run on this CPU (Auto and Scalar always can)
+bool is_supported(LeniaBackend backend);
+
+/// Resolves Auto to AVX2 or Scalar, unsupported backends fall back to Scalar
+LeniaBackend resolve(LeniaBackend backend);
+
+/// Returns the row function of \p backend (resolved first), the Eigen backend has none and gets the scalar one
+RowFunction row_function(LeniaBackend backend);
+
+const char* backend_name(LeniaBackend backend);
+
+} // namespace simd
+
+} // namespace meshlife
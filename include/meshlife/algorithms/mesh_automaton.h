@@ -1,7 +1,10 @@
 #pragma once
 
+#include <meshlife/triple_buffer.h>
 #include <pmp/surface_mesh.h>
 
+#include <vector>
+
 namespace meshlife
 {
 
@@ -12,6 +15,8 @@ class MeshAutomaton
     /// Create a base automaton algorithm instance working on \p mesh
     MeshAutomaton(pmp::SurfaceMesh& mesh);
 
+    virtual ~MeshAutomaton() = default;
+
     /// Allocates the properties to store current and last state.
     /// Must be called before initializing the state
     virtual void allocate_needed_properties();
@@ -45,11 +50,32 @@ class MeshAutomaton
         return state_;
     }
 
+    /// Copies the current state into the published snapshot, which another thread (e.g. the renderer) reads while the
+    /// automaton keeps updating. Must be called from the thread that updates the state, never blocks.
+    /// This is an O(F) copy: swap_states() only removes the copy between the steps, the state itself stays owned by
+    /// the face property and has to remain readable after publishing.
+    /// Unless \p force is set, nothing is copied while the reader has not picked up the last snapshot, so states
+    /// updated faster than they are drawn cost no copy. Returns whether the state was published.
+    bool publish_state(bool force = false);
+
+    /// Switches published_state() to the newest snapshot, returns false if none was published since the last call.
+    /// Must only be called from one (reader) thread, never blocks.
+    inline bool update_published_state()
+    {
+        return published_.update();
+    }
+
+    /// The snapshot selected by the last update_published_state(), stays consistent while the state gets updated
+    inline const std::vector<float>& published_state() const
+    {
+        return published_.read_buffer();
+    }
+
     int p_upper_threshold_ = 3;
     int p_lower_threshold_ = 2;
 
   protected:
-    /// Convenience function that swaps current and last state.
+    /// Swaps current and last state, steps start with this instead of copying the state
     inline void swap_states()
     {
         std::swap(state_, last_state_);
@@ -58,6 +84,9 @@ class MeshAutomaton
     pmp::SurfaceMesh& mesh_;
     pmp::FaceProperty<float> state_;      /// The current state for each cell = face
     pmp::FaceProperty<float> last_state_; /// Allows editing current state while reading from unchanged last state
+
+  private:
+    TripleBuffer<std::vector<float>> published_;
 };
 
 } // namespace meshlife
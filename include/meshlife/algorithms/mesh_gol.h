@@ -1,5 +1,7 @@
 #pragma once
 
+#include "binary_gol.h"
+#include "helpers.h"
 #include "mesh_automaton.h"
 #include <pmp/surface_mesh.h>
 
@@ -20,6 +22,23 @@ class MeshGOL : public MeshAutomaton
     void init_state_random() override;
     /// Allocates the properties to store current and last state.
     /// Must be called before initializing the state
+    void allocate_needed_properties() override;
+
+    /// Builds the face adjacency table, has to be redone whenever the mesh topology changes
+    void precompute() override;
+
+    /// Step with the bit-packed engine while all states are exactly 0 or 1. Every update_state() call packs and
+    /// unpacks the float states, the bits are kept in addition to them. Off by default: single steps are slower than
+    /// the gather loop, and on spatially reordered meshes the shifted slot reads do not apply.
+    bool p_bit_packed_ = false;
+
+  private:
+    helpers::FaceAdjacency adjacency_;
+
+    /// Topology the adjacency table was built for
+    helpers::TopologyFingerprint adjacency_fingerprint_;
+
+    BinaryGOL binary_gol_;
 };
 
 } // namespace meshlife
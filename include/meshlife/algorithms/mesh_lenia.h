@@ -1,15 +1,41 @@
 #pragma once
+#include <meshlife/algorithms/helpers.h>
+#include <meshlife/algorithms/lenia_simd.h>
 #include <meshlife/algorithms/mesh_automaton.h>
 
 #include <pmp/surface_mesh.h>
 
+#include <Eigen/Sparse>
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
 namespace meshlife
 {
 
+/// Normalized Lenia convolution kernel as structure of arrays in compressed sparse row format.
+/// The potential of face i is the sum of weights[j] * state[indices[j]] for j in [offsets[i], offsets[i + 1]).
+/// The weights already contain the neighbor face area and the division by the kernel shell length.
+struct LeniaKernel
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> indices;
+    std::vector<float> weights;
+
+    /// Number of faces (rows) of the kernel
+    inline size_t size() const
+    {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+};
+
 class MeshLenia : public MeshAutomaton
 {
   public:
-    MeshLenia(pmp::SurfaceMesh& mesh);
+    /// Creates the automaton on \p mesh. With \p precache false the (expensive) neighborhood computation is skipped,
+    /// allocate_needed_properties() has to be called after setting the parameters then.
+    MeshLenia(pmp::SurfaceMesh& mesh, bool precache = true);
 
     /// Initialize the state randomly, must be defined when inheriting
     void init_state_random() override;
@@ -25,13 +51,14 @@ class MeshLenia : public MeshAutomaton
 
     void visualize_kernel_skeleton();
 
-    float merged_together(const pmp::Face& x);
+    /// Potential (normalized kernel convolution of the last state) at face \p x
+    float merged_together(const pmp::Face& x) const;
 
     /// Returns value of exponential function at r with parameter a
     float exponential_kernel(float r, float a);
 
     ///
-    float exponential_growth(float u, float mu, float sigma);
+    float exponential_growth(float u, float mu, float sigma) const;
 
     float norm_check();
 
@@ -43,12 +70,54 @@ class MeshLenia : public MeshAutomaton
     typedef std::vector<Neighbor> Neighbors;
     typedef std::vector<Neighbors> NeighborMap;
 
+    /// Computes the neighborhoods (distance stage) and the kernel (weight stage), or loads both from the neighborhood
+    /// cache
     void precache_face_values();
 
+    /// Applies a changed p_neighborhood_radius_. A smaller radius filters the current neighbor lists, only a larger
+    /// radius or a changed mesh computes the neighborhoods again. The kernel weights are recomputed in both cases.
+    void update_neighborhood_radius();
+
+    /// Radius the current neighborhoods were computed or filtered for
+    inline float neighborhood_radius_computed() const
+    {
+        return neighborhood_radius_computed_;
+    }
+
+    /// Hash of everything the neighborhoods and the kernel depend on: the mesh geometry, the radius, the beta peaks
+    /// and the metric (geodesic or euclidean)
+    uint64_t neighborhood_cache_key(bool geodesic) const;
+
+    /// File of the neighborhood cache for the \p geodesic or euclidean metric, empty if the cache is disabled
+    std::filesystem::path neighborhood_cache_file(bool geodesic) const;
+
     bool is_closed_mesh();
 
+    /// Computes the kernel weights from the neighbor distances, must be called after the neighborhoods or the
+    /// beta peaks changed
     void kernel_precompute();
 
+    /// Get the precomputed normalized kernel
+    inline const LeniaKernel& kernel() const
+    {
+        return kernel_;
+    }
+
+    /// Get the unnormalized kernel sum of every face, faces with 0 have no valid potential
+    inline const std::vector<float>& kernel_shell_lengths() const
+    {
+        return kernel_shell_length_;
+    }
+
+    typedef Eigen::SparseMatrix<float, Eigen::RowMajor> KernelMatrix;
+
+    /// Get the normalized kernel as sparse matrix, row i holds the weights of face i.
+    /// Only assembled while the Eigen backend is in use, empty otherwise.
+    inline const KernelMatrix& kernel_matrix() const
+    {
+        return kernel_matrix_;
+    }
+
     float distance_neighbors(const Neighbor& n);
 
     float kernel_shell(float r);
@@ -59,7 +128,7 @@ class MeshLenia : public MeshAutomaton
     float kernel_shell_length(const Neighbors& n);
     float kernel_skeleton(float r, const std::vector<float>& beta);
     float k(const Neighbor& n, const Neighbors& neighborhood);
-    float growth(float f, float mu, float sigma);
+    float growth(float f, float mu, float sigma) const;
 
     float p_mu_ = 0.581;
     float p_sigma_ = 0.131;
@@ -72,11 +141,48 @@ class MeshLenia : public MeshAutomaton
 
     int p_T_ = 10;
 
+    /// Path prefix of the neighborhood cache, usually the file the mesh was loaded from. precache_face_values() stores
+    /// its results in "<prefix>.<geodesic|euclidean>.neighbors" next to it and reads that file instead of computing
+    /// them again as long as its key matches. There is one file per mesh and metric, a computation with another key
+    /// (e.g. after changing the radius) replaces it. Empty disables the cache.
+    std::filesystem::path p_neighborhood_cache_;
+
+    /// Backend used for the convolution in update_state(). The SIMD backends sum in a different order than the
+    /// scalar one, potentials differ in the order of float epsilon times the number of neighbors.
+    LeniaBackend p_backend_ = LeniaBackend::Auto;
+
   private:
     std::vector<float> kernel_shell_length_;
 
     NeighborMap neighbor_map_;
 
+    /// radius and topology of the mesh the neighbor_map_ belongs to
+    float neighborhood_radius_computed_ = 0;
+    helpers::TopologyFingerprint neighborhood_fingerprint_;
+
+    /// Drops the neighbors farther away than \p radius (at most the current one) and rescales their distances to it
+    void filter_neighborhoods(float radius);
+
+    LeniaKernel kernel_;
+
+    KernelMatrix kernel_matrix_;
+
+    /// Potential of every face, output of the SpMV of the Eigen backend
+    Eigen::VectorXf potential_;
+
+    /// Copies kernel_ into kernel_matrix_
+    void assemble_kernel_matrix();
+
+    /// Assembles kernel_matrix_ if the Eigen backend is selected, otherwise frees it
+    void update_kernel_matrix();
+
+    /// Fills the neighborhoods and the kernel from the cache file \p path, returns false if it is missing, invalid or
+    /// was written for another \p key
+    bool load_neighborhood_cache(const std::filesystem::path& path, uint64_t key);
+
+    /// Writes the neighborhoods and the kernel to \p path, returns false on errors
+    bool save_neighborhood_cache(const std::filesystem::path& path, uint64_t key) const;
+
     /// Find face with lowest distance to all other facestamp
     pmp::Face find_center_face();
 
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <meshlife/algorithms/mesh_lenia.h>
+
+#include <pmp/surface_mesh.h>
+
+#include <vector>
+
+namespace meshlife
+{
+
+/// Growth parameters of one lane of a MeshLeniaBatch
+struct LeniaParameters
+{
+    float mu = 0.581;
+    float sigma = 0.131;
+    int T = 10;
+};
+
+/// Evolves several Lenia states with different growth parameters side by side over the kernel of one MeshLenia.
+/// The states are interleaved (state of lane l at face i is at i * lanes() + l), so every gathered neighbor feeds all
+/// lanes and the neighborhoods and weights are read once per step for the whole batch.
+/// Each lane produces the same result as a MeshLenia with the Scalar backend and the lane's parameters.
+class MeshLeniaBatch
+{
+  public:
+    /// Creates a batch with one lane per entry of \p parameters, all states zero.
+    /// The kernel of \p lenia is used by reference, \p lenia must outlive the batch and not be recomputed meanwhile.
+    MeshLeniaBatch(const MeshLenia& lenia, const std::vector<LeniaParameters>& parameters);
+
+    inline size_t lanes() const
+    {
+        return parameters_.size();
+    }
+
+    inline size_t faces() const
+    {
+        return lenia_.kernel().size();
+    }
+
+    inline const LeniaParameters& parameters(size_t lane) const
+    {
+        return parameters_[lane];
+    }
+
+    /// Initialize the states of all lanes randomly
+    void init_state_random();
+
+    /// Copy the state of \p lane from \p prop
+    void set_state(size_t lane, const pmp::FaceProperty<float>& prop);
+
+    /// Copy the state of \p lane to \p prop, e.g. to display it with the state property of \p lenia
+    void get_state(size_t lane, pmp::FaceProperty<float>& prop) const;
+
+    /// Get the state of \p lane at face \p f
+    inline float state(size_t lane, const pmp::Face& f) const
+    {
+        return state_[f.idx() * lanes() + lane];
+    }
+
+    /// Update all lanes by computing \p num_steps timesteps
+    void update_state(int num_steps);
+
+  private:
+    const MeshLenia& lenia_;
+    std::vector<LeniaParameters> parameters_;
+
+    std::vector<float> state_;
+    std::vector<float> last_state_;
+};
+
+} // namespace meshlife
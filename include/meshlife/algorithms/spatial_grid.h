@@ -0,0 +1,47 @@
+#pragma once
+
+#include <pmp/surface_mesh.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace meshlife
+{
+
+/// Uniform grid over a fixed point set for fixed radius neighbor queries.
+/// Points are bucketed by cell in compressed sparse row format, a query only visits the cells overlapping the
+/// bounding box of the query sphere.
+class SpatialGrid
+{
+  public:
+    /// Builds the grid over \p points with cells of (at least) edge length \p cell_size
+    SpatialGrid(const std::vector<pmp::Point>& points, pmp::Scalar cell_size);
+
+    /// Appends the indices of all points within \p radius of \p p to \p result, sorted by index
+    void query(const pmp::Point& p, pmp::Scalar radius, std::vector<uint32_t>& result) const;
+
+    inline const std::vector<pmp::Point>& points() const
+    {
+        return points_;
+    }
+
+  private:
+    inline size_t cell_index(int x, int y, int z) const
+    {
+        return ((size_t)z * resolution_[1] + y) * resolution_[0] + x;
+    }
+
+    int cell_coordinate(pmp::Scalar value, int axis) const;
+
+    const std::vector<pmp::Point>& points_;
+
+    pmp::Point origin_;
+    pmp::Scalar cell_size_;
+    int resolution_[3];
+
+    /// points of cell c are cell_points_[cell_offsets_[c]] ... cell_points_[cell_offsets_[c + 1] - 1]
+    std::vector<uint32_t> cell_offsets_;
+    std::vector<uint32_t> cell_points_;
+};
+
+} // namespace meshlife
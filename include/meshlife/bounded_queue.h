@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace meshlife
+{
+
+/// Lock-free bounded multi producer, multi consumer queue (Dmitry Vyukov's ring of sequence numbered cells).
+/// push() and pop() never block, they fail if the queue is full or empty. Producers and consumers only contend on
+/// their own end of the ring.
+template <typename T>
+class BoundedQueue
+{
+  public:
+    explicit BoundedQueue(size_t capacity = 1)
+    {
+        reset(capacity);
+    }
+
+    /// Empties the queue and resizes it to at least \p capacity entries (rounded up to a power of two).
+    /// Not thread-safe, no other thread may use the queue meanwhile.
+    void reset(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size *= 2;
+        cells_ = std::make_unique<Cell[]>(size);
+        mask_ = size - 1;
+        for (size_t i = 0; i < size; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    /// Appends \p value, returns false if the queue is full
+    bool push(const T& value)
+    {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            // the cell is free for this position, claim it
+            if (diff == 0 && tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+            // the cell still holds the value of the previous round
+            if (diff < 0)
+                return false;
+            if (diff > 0)
+                pos = tail_.load(std::memory_order_relaxed);
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Removes the oldest value into \p value, returns false if the queue is empty
+    bool pop(T& value)
+    {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+            if (diff == 0 && head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+            // nothing was pushed to this cell yet
+            if (diff < 0)
+                return false;
+            if (diff > 0)
+                pos = head_.load(std::memory_order_relaxed);
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Number of entries, only a snapshot while other threads use the queue
+    size_t size() const
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+  private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+
+    // on separate cache lines, so producers and consumers do not invalidate each other's position
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+} // namespace meshlife
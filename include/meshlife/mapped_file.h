@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace meshlife
+{
+
+/// Read-only memory mapping of a whole file. Pages are loaded by the OS when they are first accessed, so opening
+/// is cheap and only the parts that are read cost I/O.
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    /// Maps \p path, returns false with errno set if it can not be opened or is empty
+    bool open(const std::filesystem::path& path);
+
+    void close();
+
+    inline bool is_open() const
+    {
+        return data_ != nullptr;
+    }
+
+    inline const uint8_t* data() const
+    {
+        return data_;
+    }
+
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+  private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace meshlife
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "meshlife/algorithms/helpers.h"
+#include "pmp/mat_vec.h"
+#include "pmp/surface_mesh.h"
+
+#include <limits>
+#include <vector>
+
+namespace meshlife
+{
+
+/// Vertex arrays of a mesh as drawn by the CustomRenderer, built without any OpenGL calls.
+/// Faces are tessellated into triangles. Smooth shaded meshes share one vertex per mesh vertex and are drawn indexed
+/// with triangle_indices(), otherwise every triangle gets its own copy of its corners (for flat shading, per halfedge
+/// texture coordinates and face colors). The edge index arrays refer to the vertices of the chosen layout.
+class MeshBuffers
+{
+  public:
+    /// Rebuilds all arrays from \p mesh. Normals are smoothed over edges with a dihedral angle below \p crease_angle
+    /// (in degrees), colors are taken from "v:color" or "f:color" if \p use_colors is set.
+    /// Uses the indexed layout for crease angles above 170 degrees if no corner needs its own attributes.
+    void build(const pmp::SurfaceMesh& mesh, float crease_angle, bool use_colors);
+
+    /// Marks the vertex positions or the connectivity as changed, so the next build() tessellates the faces again.
+    /// Builds in between reuse the cached triangles of every face, only a changed topology is detected on its own.
+    inline void invalidate_geometry()
+    {
+        geometry_revision_++;
+    }
+
+    /// Whether the vertices are shared and the triangles must be drawn with triangle_indices()
+    inline bool indexed() const
+    {
+        return indexed_;
+    }
+
+    /// Three vertex indices per triangle, only filled in the indexed layout
+    inline const std::vector<uint32_t>& triangle_indices() const
+    {
+        return triangle_indices_;
+    }
+
+    /// Mesh face index of every triangle (matches gl_PrimitiveID), only filled in the indexed layout
+    inline const std::vector<uint32_t>& triangle_faces() const
+    {
+        return triangle_faces_;
+    }
+
+    inline const std::vector<pmp::vec3>& positions() const
+    {
+        return positions_;
+    }
+
+    inline const std::vector<pmp::vec3>& normals() const
+    {
+        return normals_;
+    }
+
+    inline const std::vector<pmp::vec2>& tex_coords() const
+    {
+        return tex_coords_;
+    }
+
+    inline const std::vector<pmp::vec3>& colors() const
+    {
+        return colors_;
+    }
+
+    /// Index of the mesh face every vertex belongs to, empty for point clouds and the indexed layout
+    inline const std::vector<uint32_t>& face_ids() const
+    {
+        return corner_faces_;
+    }
+
+    /// Pairs of vertex indices of all edges
+    inline const std::vector<unsigned int>& edge_indices() const
+    {
+        return edge_indices_;
+    }
+
+    /// Pairs of vertex indices of the edges marked in "e:feature"
+    inline const std::vector<unsigned int>& feature_indices() const
+    {
+        return feature_indices_;
+    }
+
+  private:
+    std::vector<pmp::vec3> positions_;
+    std::vector<pmp::vec3> normals_;
+    std::vector<pmp::vec2> tex_coords_;
+    std::vector<pmp::vec3> colors_;
+    std::vector<unsigned int> edge_indices_;
+    std::vector<unsigned int> feature_indices_;
+
+    bool indexed_ = false;
+    std::vector<uint32_t> triangle_indices_;
+    std::vector<uint32_t> triangle_faces_;
+
+    /// mesh face every entry of the duplicated vertex arrays was copied from
+    std::vector<uint32_t> corner_faces_;
+
+    /// Fills the arrays of the indexed layout, one vertex per mesh vertex index
+    void build_indexed(const pmp::SurfaceMesh& mesh, bool use_colors);
+
+    /// triangles of face f are face_triangles_[face_triangle_offsets_[f.idx()] .. face_triangle_offsets_[f.idx() + 1]],
+    /// given as corner numbers counted from the first halfedge of the face
+    std::vector<uint32_t> face_triangle_offsets_;
+    std::vector<pmp::ivec3> face_triangles_;
+
+    /// the tessellation is valid while both match the mesh
+    uint64_t geometry_revision_ = 1;
+    uint64_t tessellation_revision_ = 0;
+    helpers::TopologyFingerprint tessellation_fingerprint_;
+
+    /// Tessellates all faces again if the geometry changed since the last call
+    void update_tessellation(const pmp::SurfaceMesh& mesh);
+
+    /// Minimum area triangulation of polygons, keeps its table between calls. Not thread-safe, use one per thread.
+    class Tessellator
+    {
+      public:
+        // triangulate a polygon such that the sum of squared triangle areas is minimized.
+        // this prevents overlapping/folding triangles for non-convex polygons.
+        void tesselate(const std::vector<pmp::vec3>& points, std::vector<pmp::ivec3>& triangles);
+
+      private:
+        // helpers for computing triangulation of a polygon
+        struct Triangulation
+        {
+            Triangulation(pmp::Scalar a = std::numeric_limits<pmp::Scalar>::max(), int s = -1) : area_(a), split_(s)
+            {
+            }
+            pmp::Scalar area_;
+            int split_;
+        };
+
+        // access triangulation array
+        inline Triangulation& triangulation(int start, int end)
+        {
+            return triangulation_[polygon_valence_ * start + end];
+        }
+
+        // table to hold triangulation data
+        std::vector<Triangulation> triangulation_;
+
+        // valence of currently triangulated polygon
+        unsigned int polygon_valence_ = 0;
+
+        // compute squared area of triangle. used for triangulate().
+        inline pmp::Scalar area(const pmp::vec3& p0, const pmp::vec3& p1, const pmp::vec3& p2) const
+        {
+            return sqrnorm(cross(p1 - p0, p2 - p0));
+        }
+
+        // reserve n*n array for computing triangulation
+        inline void init_triangulation(unsigned int n)
+        {
+            triangulation_.clear();
+            triangulation_.resize(n * n);
+            polygon_valence_ = n;
+        }
+    };
+};
+
+} // namespace meshlife
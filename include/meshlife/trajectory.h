@@ -0,0 +1,185 @@
+#pragma once
+
+#include "meshlife/mapped_file.h"
+#include "pmp/surface_mesh.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace meshlife
+{
+
+/// How the state of a face is stored in a trajectory frame
+enum class TrajectoryEncoding : uint8_t
+{
+    Float32 = 0, ///< 4 bytes per face, lossless
+    UInt8 = 1,   ///< 1 byte per face, the state clamped to [0, 1] in steps of 1/255
+    Bits = 2     ///< 1 bit per face, alive if the state is at least 0.5 (Game of Life)
+};
+
+/// Compression of the encoded frames
+enum class TrajectoryCompression : uint8_t
+{
+    None = 0,
+    /// every frame except the keyframes is XORed with the previous encoded frame, then all frames store runs of zero
+    /// bytes by their length. Slowly changing or sparse states shrink a lot.
+    DeltaRLE = 1
+};
+
+/// Fixed size header at the start of a trajectory file, followed by the parameter text and the frames.
+/// Values are stored in host byte order.
+struct TrajectoryHeader
+{
+    char magic_[8] = {'M', 'L', 'T', 'R', 'A', 'J', '1', '\0'};
+    uint32_t version_ = 1;
+    TrajectoryEncoding encoding_ = TrajectoryEncoding::Float32;
+    TrajectoryCompression compression_ = TrajectoryCompression::None;
+    uint16_t reserved_ = 0;
+    /// every keyframe_interval_-th frame can be decoded on its own, the others need the frames before
+    uint32_t keyframe_interval_ = 32;
+    /// length of the "key=value\n" parameter text that follows the header
+    uint32_t parameters_size_ = 0;
+    /// number of states per frame, mesh.faces_size() of the simulated mesh
+    uint64_t n_faces_ = 0;
+    uint64_t connectivity_hash_ = 0;
+    uint64_t geometry_hash_ = 0;
+};
+
+/// Header in front of the payload of every frame
+struct TrajectoryFrameHeader
+{
+    static constexpr uint32_t MAGIC = 0x4d415246; // "FRAM"
+    static constexpr uint32_t KEYFRAME = 0x1;
+
+    uint32_t magic_ = MAGIC;
+    uint32_t flags_ = 0;
+    /// simulation step of the state
+    uint64_t step_ = 0;
+    uint64_t payload_size_ = 0;
+};
+
+/// Appends the states of a simulation to a trajectory file. Frames are encoded and written on the calling thread, so
+/// it can run directly on the simulation thread. Not thread-safe.
+class TrajectoryWriter
+{
+  public:
+    ~TrajectoryWriter();
+
+    /// Creates \p path for states of \p mesh. \p parameters is stored as text, by convention "key=value" lines.
+    /// Returns false (and prints the reason) if the file can not be written.
+    bool open(const std::filesystem::path& path, const pmp::SurfaceMesh& mesh, TrajectoryEncoding encoding,
+              TrajectoryCompression compression, const std::string& parameters, uint32_t keyframe_interval = 32);
+
+    /// Appends the state of \p step, \p state holds header().n_faces_ values in face index order
+    bool write(uint64_t step, const float* state);
+
+    inline bool write(uint64_t step, const std::vector<float>& state)
+    {
+        return write(step, state.data());
+    }
+
+    /// Flushes and closes the file, further writes fail until the next open()
+    void close();
+
+    inline bool is_open() const
+    {
+        return file_ != nullptr;
+    }
+
+    inline size_t frames_written() const
+    {
+        return frames_written_;
+    }
+
+    inline uint64_t bytes_written() const
+    {
+        return bytes_written_;
+    }
+
+    inline const TrajectoryHeader& header() const
+    {
+        return header_;
+    }
+
+  private:
+    FILE* file_ = nullptr;
+    TrajectoryHeader header_;
+    size_t frames_written_ = 0;
+    uint64_t bytes_written_ = 0;
+
+    std::vector<uint8_t> encoded_;
+    std::vector<uint8_t> previous_;
+    std::vector<uint8_t> payload_;
+};
+
+/// Random access to the frames of a trajectory file. The file is memory-mapped, so only the pages of the decoded
+/// frames are read. Sequential reads reuse the previously decoded frame, a jump decodes from the nearest keyframe.
+class TrajectoryReader
+{
+  public:
+    ~TrajectoryReader();
+
+    /// Maps \p path and indexes its frames. A truncated last frame (e.g. of a crashed run) is ignored.
+    /// Returns false (and prints the reason) if the file is missing or no trajectory.
+    bool open(const std::filesystem::path& path);
+
+    void close();
+
+    inline bool is_open() const
+    {
+        return file_.is_open();
+    }
+
+    /// Whether the states are stored per face index of \p mesh, its vertex positions may differ
+    bool matches(const pmp::SurfaceMesh& mesh) const;
+
+    inline const TrajectoryHeader& header() const
+    {
+        return header_;
+    }
+
+    inline const std::string& parameters() const
+    {
+        return parameters_;
+    }
+
+    inline size_t n_frames() const
+    {
+        return frames_.size();
+    }
+
+    /// Simulation step of frame \p i
+    inline uint64_t step(size_t i) const
+    {
+        return frames_[i].step_;
+    }
+
+    /// Decodes frame \p i into \p state (n_faces_ values), returns false if the frame is corrupt
+    bool read(size_t i, std::vector<float>& state);
+
+  private:
+    struct Frame
+    {
+        uint64_t step_;
+        size_t offset_; ///< of the payload
+        size_t size_;
+        bool keyframe_;
+    };
+
+    MappedFile file_;
+    TrajectoryHeader header_;
+    std::string parameters_;
+    std::vector<Frame> frames_;
+
+    /// encoded bytes of frame decoded_frame_, the base of the next delta frame
+    std::vector<uint8_t> decoded_;
+    size_t decoded_frame_ = SIZE_MAX;
+
+    /// Decodes the payload of frame \p i on top of decoded_ (the previous frame for delta frames)
+    bool decode(size_t i);
+};
+
+} // namespace meshlife
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace meshlife
+{
+
+/// Lock-free single producer, single consumer channel that always hands the newest complete value to the reader.
+/// The writer fills write_buffer() and publishes it, the reader picks up the latest published buffer with update().
+/// Neither side ever waits for the other, values published while the reader is busy are skipped.
+template <typename T>
+class TripleBuffer
+{
+  public:
+    /// Buffer owned by the writer, only valid until the next publish()
+    inline T& write_buffer()
+    {
+        return buffers_[back_];
+    }
+
+    /// Makes the write buffer the newest value, the writer continues with another buffer
+    inline void publish()
+    {
+        back_ = middle_.exchange(back_ | NEW_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    /// Whether the reader took the last published value, only meaningful on the writer side. Until it does, the
+    /// writer may skip filling another buffer, the reader would only ever see the newest one anyway.
+    inline bool consumed() const
+    {
+        return !(middle_.load(std::memory_order_relaxed) & NEW_BIT);
+    }
+
+    /// Switches the read buffer to the newest value, returns false if nothing was published since the last call
+    inline bool update()
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & NEW_BIT))
+            return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    /// Buffer owned by the reader, stays unchanged until the next update()
+    inline const T& read_buffer() const
+    {
+        return buffers_[front_];
+    }
+
+  private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t NEW_BIT = 0x4;
+
+    T buffers_[3];
+    uint8_t back_ = 0;               ///< only used by the writer
+    std::atomic<uint8_t> middle_{1}; ///< last published buffer, NEW_BIT is set while the reader has not taken it
+    uint8_t front_ = 2;              ///< only used by the reader
+};
+
+} // namespace meshlife
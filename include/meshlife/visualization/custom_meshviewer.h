@@ -25,8 +25,9 @@ class CustomMeshViewer : public pmp::TrackballViewer
 
     //! update mesh normals and all buffers for OpenGL rendering.  call this
     //! function whenever you change either the vertex positions or the
-    //! triangulation of the mesh
-    void update_mesh();
+    //! triangulation of the mesh. pass false for \p geometry_changed if only
+    //! the scene (e.g. the mesh scale) changed, then the tessellation is reused
+    void update_mesh(bool geometry_changed = true);
 
     //! draw the scene in different draw modes
     void draw(const std::string& draw_mode) override;
@@ -2,6 +2,7 @@
 
 #include <cmath>
 
+#include "meshlife/mesh_buffers.h"
 #include "pmp/mat_vec.h"
 #include "pmp/surface_mesh.h"
 #include "pmp/types.h"
@@ -29,6 +30,16 @@ enum class CamDirection
     COUNT
 };
 
+/// Maps the automaton state of a face to its color, evaluated in the fragment shaders
+enum class Colormap
+{
+    Rainbow,
+    Viridis,
+    Inferno,
+    Grayscale,
+    COUNT
+};
+
 class CustomRenderer
 {
   public:
@@ -45,6 +56,29 @@ class CustomRenderer
     //! Update all OpenGL buffers for rendering.
     void update_opengl_buffers();
 
+    //! Call after moving vertices or changing the connectivity of the mesh, before update_opengl_buffers().
+    //! Other buffer updates reuse the cached tessellation of the faces.
+    void invalidate_geometry()
+    {
+        buffers_.invalidate_geometry();
+    }
+
+    //! Upload the automaton state with one value per face index. Faces are then colored by colormap_ on the GPU
+    //! instead of by their vertex colors, as long as the state size fits the mesh.
+    void update_state_buffer(const std::vector<float>& state);
+
+    //! Face drawn at the cursor position (\p x, \p y) in framebuffer pixels, invalid on the background.
+    //! Renders the face indices of the last drawn view into an offscreen integer buffer (at most once per frame)
+    //! and reads back a single pixel, so repeated picks while dragging stay cheap.
+    pmp::Face pick_face(int x, int y);
+
+    //! Whether pick_face() can find faces: the draw mode shows the triangles and the face index pass could be set up
+    //! (shader and framebuffer). Otherwise it never finds a face, even under the cursor.
+    inline bool pick_pass_available() const
+    {
+        return pick_faces_drawn_ && !pick_pass_failed_;
+    }
+
     void set_simple_shader_files(std::string simple_shader_path_vertex, std::string simple_shader_path_fragment);
 
     void set_skybox_shader_files(std::string vertex_shader_file_path, std::string fragment_shader_file_path);
@@ -110,6 +144,13 @@ class CustomRenderer
         pmp::vec3(0, degree_to_rad(0), degree_to_rad(180)),
     };
 
+    const std::vector<std::string> colormap_names_ = {
+        "Rainbow",
+        "Viridis",
+        "Inferno",
+        "Grayscale",
+    };
+
     const std::vector<pmp::vec3> colors_ = {
         pmp::vec3(1.0, 0.0, 0.0),
         pmp::vec3(0.0, 1.0, 0.0),
@@ -128,6 +169,7 @@ class CustomRenderer
     float point_size_;
     float reflectiveness_;
     bool use_lighting_ = true;
+    Colormap colormap_ = Colormap::Rainbow;
 
     bool store_skybox_to_file_ = false;
     bool offset_skybox_ = false;
@@ -182,6 +224,9 @@ class CustomRenderer
         -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f,
         1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, 1.0f};
 
+    // vertex arrays of the last update_opengl_buffers()
+    MeshBuffers buffers_;
+
     // OpenGL buffers
     GLuint MESH_VAO_ = 0;
     GLuint MESH_vertex_buffer_ = 0;
@@ -190,13 +235,34 @@ class CustomRenderer
     GLuint MESH_tex_coord_buffer_ = 0;
     GLuint MESH_edge_buffer_ = 0;
     GLuint MESH_feature_buffer_ = 0;
+    GLuint MESH_face_id_buffer_ = 0;
+    GLuint MESH_state_buffer_ = 0;
+    GLuint MESH_state_texture_ = 0;
+    GLuint MESH_index_buffer_ = 0;
+    GLuint MESH_triangle_face_buffer_ = 0;
+    GLuint MESH_triangle_face_texture_ = 0;
+
+    // offscreen face index pass for picking, redrawn on demand after the view or the buffers changed
+    GLuint pick_framebuffer_ = 0;
+    GLuint pick_face_buffer_ = 0;
+    GLuint pick_depth_buffer_ = 0;
+    int pick_width_ = 0;
+    int pick_height_ = 0;
+    bool pick_pass_valid_ = false;
+    bool pick_faces_drawn_ = false;
+    bool pick_pass_failed_ = false;
+    pmp::mat4 pick_mvp_matrix_ = pmp::mat4::identity();
 
     GLsizei n_vertices_ = 0;
+    GLsizei n_indices_ = 0;
     GLsizei n_edges_ = 0;
     GLsizei n_triangles_ = 0;
     GLsizei n_features_ = 0;
     bool has_texcoords_ = false;
     bool has_vertex_colors_ = false;
+    bool has_face_ids_ = false;
+    size_t n_state_values_ = 0;
+    size_t state_buffer_size_ = 0;
 
     GLuint skybox_VAO_ = 0;
     GLuint skybox_VBO_ = 0;
@@ -216,6 +282,7 @@ class CustomRenderer
     pmp::Shader skybox_shader_;
     pmp::Shader reflective_sphere_shader_;
     pmp::Shader phong_shader_;
+    pmp::Shader face_id_shader_;
 
     std::string simple_shader_path_vertex_;
     std::string simple_shader_path_fragment_;
@@ -231,51 +298,20 @@ class CustomRenderer
 
     void draw_face(int face_side, pmp::vec3 model_pos);
 
-    void create_cube_texture_if_not_exist();
+    // binds the state textures and sets the face state uniforms of shader
+    void bind_face_state(pmp::Shader& shader);
 
-    void draw_skybox(pmp::mat4 projection_matrix, pmp::mat4 view_matrix);
+    // draws the mesh triangles, indexed or from the duplicated vertices
+    void draw_triangles();
 
-    unsigned int load_cubemap(std::vector<std::string> faces);
-
-    // helpers for computing triangulation of a polygon
-    struct Triangulation
-    {
-        Triangulation(pmp::Scalar a = std::numeric_limits<pmp::Scalar>::max(), int s = -1) : area_(a), split_(s)
-        {
-        }
-        pmp::Scalar area_;
-        int split_;
-    };
-
-    // access triangulation array
-    inline Triangulation& triangulation(int start, int end)
-    {
-        return triangulation_[polygon_valence_ * start + end];
-    }
-
-    // table to hold triangulation data
-    std::vector<Triangulation> triangulation_;
+    // renders the face indices of the last drawn view into the picking framebuffer
+    void draw_face_id_pass();
 
-    // valence of currently triangulated polygon
-    unsigned int polygon_valence_;
-
-    // compute squared area of triangle. used for triangulate().
-    inline pmp::Scalar area(const pmp::vec3& p0, const pmp::vec3& p1, const pmp::vec3& p2) const
-    {
-        return sqrnorm(cross(p1 - p0, p2 - p0));
-    }
+    void create_cube_texture_if_not_exist();
 
-    // reserve n*n array for computing triangulation
-    inline void init_triangulation(unsigned int n)
-    {
-        triangulation_.clear();
-        triangulation_.resize(n * n);
-        polygon_valence_ = n;
-    }
+    void draw_skybox(pmp::mat4 projection_matrix, pmp::mat4 view_matrix);
 
-    // triangulate a polygon such that the sum of squared triangle areas is minimized.
-    // this prevents overlapping/folding triangles for non-convex polygons.
-    void tesselate(const std::vector<pmp::vec3>& points, std::vector<pmp::ivec3>& triangles);
+    unsigned int load_cubemap(std::vector<std::string> faces);
 };
 
 } // namespace meshlife
@@ -0,0 +1,42 @@
+#pragma once
+
+// Shader of the offscreen picking pass, writes the face index + 1 of every fragment into an unsigned integer
+// attachment. 0 is left for the background. Uses the same vertex attributes and triangle lookup as phong.vert/.frag.
+
+// clang-format off
+
+static const char* face_id_vshader = R"glsl(
+#version 330
+
+layout (location=0) in vec4 v_position;
+layout (location=4) in uint v_face_id;
+
+flat out uint v2f_face_id;
+
+uniform mat4 modelview_projection_matrix;
+
+void main()
+{
+    v2f_face_id = v_face_id;
+    gl_Position = modelview_projection_matrix * v_position;
+}
+)glsl";
+
+static const char* face_id_fshader = R"glsl(
+#version 330
+
+flat in uint v2f_face_id;
+
+uniform bool use_triangle_faces;
+uniform usamplerBuffer triangle_faces;
+
+out uint f_face;
+
+void main()
+{
+    uint face = use_triangle_faces ? texelFetch(triangle_faces, gl_PrimitiveID).r : v2f_face_id;
+    f_face = face + 1u;
+}
+)glsl";
+
+// clang-format on
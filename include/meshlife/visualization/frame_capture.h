@@ -0,0 +1,70 @@
+#pragma once
+
+#include "pmp/visualization/gl.h"
+
+#include <functional>
+#include <vector>
+
+namespace meshlife
+{
+
+/// Reads frames of the default framebuffer back asynchronously through a ring of pixel buffer objects.
+/// read() only queues the copy into the next buffer and sets a fence, collect() hands out frames whose fence has
+/// signaled. The GPU keeps rendering the next frames meanwhile instead of stalling on every readback.
+/// All calls need the OpenGL context of the window.
+class FrameCapture
+{
+  public:
+    /// RGB pixels of a frame, bottom row first, valid only during the call
+    using Consumer = std::function<void(int frame, const unsigned char* pixels)>;
+
+    ~FrameCapture();
+
+    /// (Re)allocates \p ring_size buffers for frames of \p width x \p height pixels, drops frames in flight
+    void start(int width, int height, int ring_size = 3);
+
+    /// Queues the readback of the current back buffer as \p frame, waits for the oldest frame first if the ring is
+    /// full and passes it to \p consume
+    void read(int frame, const Consumer& consume);
+
+    /// Passes all frames whose readback finished to \p consume, oldest first. With \p wait it blocks until every
+    /// queued frame is done.
+    void collect(const Consumer& consume, bool wait = false);
+
+    /// Number of frames read but not collected yet
+    inline size_t pending() const
+    {
+        return pending_;
+    }
+
+    inline int width() const
+    {
+        return width_;
+    }
+
+    inline int height() const
+    {
+        return height_;
+    }
+
+  private:
+    struct Slot
+    {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        int frame = 0;
+    };
+
+    std::vector<Slot> slots_;
+    size_t oldest_ = 0;  ///< slot of the oldest queued frame
+    size_t pending_ = 0; ///< queued frames, the next one goes to slot (oldest_ + pending_) % size
+    int width_ = 0;
+    int height_ = 0;
+
+    /// Maps the oldest slot, hands it to \p consume and frees it
+    void consume_oldest(const Consumer& consume);
+
+    void release();
+};
+
+} // namespace meshlife
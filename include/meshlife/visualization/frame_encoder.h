@@ -0,0 +1,123 @@
+#pragma once
+
+#include "meshlife/bounded_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace meshlife
+{
+
+/// Writes recorded frames as JPEG or PNG files on a fixed pool of worker threads, or streams them into an ffmpeg
+/// process that encodes a video directly.
+/// Frames are copied into one of a fixed number of slots and passed to the workers through lock-free queues. If all
+/// slots are queued, submit() waits until a worker frees the next one, so the render loop is slowed down to the
+/// encoding speed instead of stopping until everything is written.
+class FrameEncoder
+{
+  public:
+    ~FrameEncoder();
+
+    /// Allocates \p slot_count buffers for RGB frames of \p width x \p height pixels and starts the workers
+    /// (one less than the number of cores if \p n_workers is 0). \p format is ".jpg" or ".png".
+    /// Returns false if the memory for the slots is not available.
+    bool start(int width, int height, int slot_count, const std::string& format, int n_workers = 0);
+
+    /// Starts ffmpeg, which encodes the frames as H.264 video with \p framerate into \p file while they are
+    /// submitted. The raw RGB frames go through a pipe to its stdin, written in order by a single worker.
+    /// Returns false if ffmpeg is not available or the memory for the slots is not available.
+    bool start_video(int width, int height, int slot_count, int framerate, const std::filesystem::path& file);
+
+    /// Copies \p pixels (bottom row first) into a free slot and queues it to be written to \p file.
+    /// \p file is not used when streaming to ffmpeg.
+    void submit(const std::filesystem::path& file, const unsigned char* pixels);
+
+    /// Waits until all queued frames are written, stops the workers and frees the slots.
+    /// Returns false if writing a frame or encoding the video failed.
+    bool finish();
+
+    /// Whether the frames are streamed to ffmpeg instead of written as images
+    inline bool streaming() const
+    {
+        return pipe_ != nullptr;
+    }
+
+    /// Frames waiting for a worker
+    inline size_t queued() const
+    {
+        return queued_slots_.size();
+    }
+
+    inline size_t slot_count() const
+    {
+        return slots_.size();
+    }
+
+    inline size_t worker_count() const
+    {
+        return workers_.size();
+    }
+
+    /// Frames written since start()
+    inline size_t written() const
+    {
+        return written_;
+    }
+
+    /// How often submit() had to wait for a free slot since start()
+    inline size_t stalls() const
+    {
+        return stalls_;
+    }
+
+    /// Average number of frames written per second since start()
+    double frames_per_second() const;
+
+  private:
+    struct Slot
+    {
+        std::vector<unsigned char> pixels;
+        std::filesystem::path file;
+    };
+
+    std::vector<Slot> slots_;
+    BoundedQueue<uint32_t> free_slots_;
+    BoundedQueue<uint32_t> queued_slots_;
+    std::vector<std::thread> workers_;
+
+    // only used to sleep while a queue is empty, the queues themselves are lock-free
+    std::mutex mutex_;
+    std::condition_variable frame_queued_;
+    std::condition_variable slot_freed_;
+    bool stop_ = false;
+
+    std::atomic<size_t> written_ = 0;
+    std::atomic<size_t> stalls_ = 0;
+    std::chrono::steady_clock::time_point start_time_;
+
+    int width_ = 0;
+    int height_ = 0;
+    std::string format_;
+
+    // stdin of ffmpeg while streaming
+    FILE* pipe_ = nullptr;
+    std::atomic<bool> failed_ = false;
+
+    /// Allocates the slots, returns false if the memory is not available
+    bool allocate(int width, int height, int slot_count);
+
+    void start_workers(int n_workers);
+
+    void worker_func();
+
+    void write(const Slot& slot);
+};
+
+} // namespace meshlife
@@ -3,12 +3,16 @@
 #include "meshlife/algorithms/mesh_automaton.h"
 #include "meshlife/algorithms/mesh_lenia.h"
 #include "meshlife/stamps.h"
+#include "meshlife/trajectory.h"
 #include "meshlife/visualization/custom_meshviewer.h"
+#include "meshlife/visualization/frame_capture.h"
+#include "meshlife/visualization/frame_encoder.h"
 #include <bits/chrono.h>
 #include <chrono>
+#include <condition_variable>
 #include <ctime>
+#include <mutex>
 #include <pmp/stop_watch.h>
-#include <stack>
 #include <thread>
 
 namespace meshlife
@@ -62,6 +66,9 @@ class Viewer : public CustomMeshViewer
     /// thandles mouse button presses
     void mouse(int button, int action, int mods) override;
 
+    /// paints the faces under the cursor while Ctrl + right mouse button is held, otherwise moves the camera
+    void motion(double x, double y) override;
+
     /// handles keyboard events
     void keyboard(int key, int code, int action, int mod) override;
 
@@ -70,34 +77,71 @@ class Viewer : public CustomMeshViewer
 
     void do_processing() override;
 
+    /// picks the face drawn at framebuffer pixel (x, y), returns false on the background
     bool find_face(int x, int y, pmp::Face& face);
 
-    void set_face_color(pmp::Face& face, pmp::Color color);
+    /// sets \p face and the faces within brush_size_ rings around it alive
+    void paint_faces(pmp::Face face);
+
     void set_face_gol_alive(pmp::Face& face, bool alive);
 
     void read_mesh_from_file(std::string path);
 
     void on_close_callback() override;
 
-    void write_frame_to_file(std::filesystem::path filename, int buffer_idx);
+    /// passes a frame from the readback ring to the encoder
+    void store_captured_frame(int frame, const unsigned char* pixels);
 
     void start_recording();
 
     void stop_recording();
 
-    void join_recording_buffer_threads();
-
     void delete_recorded_frames();
 
     void convert_recorded_frames_to_video();
 
+    /// counts a finished simulation step and appends the state to the recorded trajectory, if any.
+    /// Called on the thread that ran the step.
+    void after_simulation_step();
+
+    void start_trajectory_recording();
+
+    void stop_trajectory_recording();
+
+    /// opens a trajectory for playback, stops the simulation. Returns false if it does not fit the current mesh.
+    bool open_trajectory(const std::filesystem::path& path);
+
+    /// shows frame \p frame of the opened trajectory instead of the automaton state
+    void show_trajectory_frame(int frame);
+
+    /// returns to the automaton state after playback
+    void close_trajectory();
+
+    /// the automaton and its parameters as "key=value" lines, stored in recorded trajectories
+    std::string trajectory_parameters() const;
+
+    /// applies changed beta peaks (only the weights) or a changed radius to the kernel of \p lenia, pauses a running
+    /// simulation meanwhile
+    void update_lenia_kernel(MeshLenia& lenia, bool radius_changed);
+
   private:
     MeshAutomaton* automaton_ = nullptr;
-    bool simulation_running_ = false;
+    std::atomic<bool> simulation_running_ = false;
     char* modelpath_buf_;
     char* peak_string_;
     stamps::Shapes selected_stamp_ = stamps::Shapes::s_none;
-    std::chrono::time_point<std::chrono::high_resolution_clock> clock_last_;
+
+    // brush painting with Ctrl + right mouse button
+    bool painting_ = false;
+    pmp::Face last_painted_face_;
+    int brush_size_ = 0;
+
+    // sort faces by a space filling curve whenever the mesh changes
+    bool reorder_faces_ = true;
+
+    // file the current mesh was loaded from, the Lenia neighborhood cache is stored next to it. Empty for generated
+    // meshes.
+    std::filesystem::path mesh_file_;
 
     std::filesystem::path recordings_path_;
     int recording_image_counter_ = 0;
@@ -106,18 +150,32 @@ class Viewer : public CustomMeshViewer
     int recording_buffer_count_ = 100;
     std::chrono::time_point<std::chrono::system_clock> recording_start_time_;
     bool recording_create_video_ = false;
+    bool recording_stream_video_ = true;
     volatile bool recording_ffmpeg_is_converting_video_ = false;
     std::thread thread_ffmpeg_;
-    std::vector<unsigned char> recording_frame_data_;
-    std::atomic<int> recording_buffer_used_ = 0;
-    std::stack<std::thread*> recording_buffer_threads_;
     std::string recording_fileformat_ = ".jpg";
+    FrameCapture frame_capture_;
+    FrameEncoder frame_encoder_;
+
+    // trajectories: states of every step, recorded on the simulation thread and played back without simulating
+    std::atomic<uint64_t> simulation_step_ = 0;
+    TrajectoryWriter trajectory_writer_;
+    std::mutex trajectory_mutex_; ///< guards trajectory_writer_, which is used by the simulation thread
+    char trajectory_path_[300] = "recordings/trajectory.mltraj";
+    int trajectory_encoding_ = (int)TrajectoryEncoding::Float32;
+    bool trajectory_compress_ = true;
+    TrajectoryReader trajectory_reader_;
+    std::vector<float> trajectory_state_;
+    int trajectory_frame_ = 0;
+    bool trajectory_playing_ = false;
+    float trajectory_fps_ = 30;
+    std::chrono::steady_clock::time_point trajectory_last_advance_;
 
     // Updates per second
     int UPS_ = 30;
     bool unlimited_limit_UPS_ = false;
 
-    double current_UPS_;
+    std::atomic<double> current_UPS_ = 0;
 
     // Debug data
     DebugData debug_data_;
@@ -127,10 +185,12 @@ class Viewer : public CustomMeshViewer
 
     std::thread simulation_thread_;
     void simulation_thread_func();
+    // wakes the simulation thread when it is stopped
+    std::mutex simulation_mutex_;
+    std::condition_variable simulation_wakeup_;
+    // set after the state was changed on the GUI thread, the next frame publishes and redraws it
     std::atomic<bool> ready_for_display_ = false;
-    bool uncomplete_updates_ = false;
 
-    pmp::Color hsv_to_rgb(float h, float s, float v);
 
     void drop(int count, const char** paths) override;
     void after_display() override;
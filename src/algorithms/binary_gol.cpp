@@ -0,0 +1,230 @@
+#include "meshlife/algorithms/binary_gol.h"
+
+#include <algorithm>
+
+namespace meshlife
+{
+
+void BinaryGOL::build(const helpers::FaceAdjacency& adjacency)
+{
+    adjacency_ = &adjacency;
+    n_faces_ = adjacency.size();
+    // one extra bit for the always dead face referenced by unused slots
+    n_words_ = (n_faces_ + 1 + 63) / 64;
+    // shifted reads may touch the word after the last one
+    bits_.assign(n_words_ + 1, 0);
+    next_bits_.assign(n_words_ + 1, 0);
+
+    size_t max_degree = 0;
+    for (size_t f = 0; f < n_faces_; f++)
+        max_degree = std::max<size_t>(max_degree, adjacency.offsets[f + 1] - adjacency.offsets[f]);
+
+    slots_.clear();
+    word_offsets_.clear();
+    n_slots_ = 0;
+    if (max_degree > MAX_SLOTS)
+        return;
+
+    n_slots_ = std::max<int>(max_degree, 1);
+    slots_.assign(n_faces_ * n_slots_, n_faces_);
+#pragma omp parallel for
+    for (size_t f = 0; f < n_faces_; f++)
+    {
+        std::copy(adjacency.indices.begin() + adjacency.offsets[f],
+                  adjacency.indices.begin() + adjacency.offsets[f + 1],
+                  slots_.begin() + f * n_slots_);
+    }
+
+    // find the slots whose neighbors are a shifted copy of the word, the neighbors are sorted by index so regular grid
+    // rows get the same offsets for all their faces
+    word_offsets_.assign(n_words_ * n_slots_, GATHER);
+#pragma omp parallel for
+    for (size_t w = 0; w < n_words_; w++)
+    {
+        const size_t begin = 64 * w;
+        const size_t end = std::min<size_t>(begin + 64, n_faces_);
+        if (begin >= end)
+            continue;
+        for (int k = 0; k < n_slots_; k++)
+        {
+            const uint32_t first = slots_[begin * n_slots_ + k];
+            const int64_t offset = first == n_faces_ ? EMPTY : (int64_t)first - (int64_t)begin;
+            bool uniform = true;
+            for (size_t f = begin + 1; f < end && uniform; f++)
+            {
+                const uint32_t s = slots_[f * n_slots_ + k];
+                uniform = offset == EMPTY ? s == n_faces_ : (s != n_faces_ && (int64_t)s - (int64_t)f == offset);
+            }
+            if (uniform && offset > GATHER)
+                word_offsets_[w * n_slots_ + k] = offset;
+        }
+    }
+
+    // gathering along padded slots is slower than along the adjacency table, only keep them when shifts dominate
+    if (shifted_slot_ratio() < 0.5)
+    {
+        n_slots_ = 0;
+        slots_.clear();
+        word_offsets_.clear();
+    }
+}
+
+double BinaryGOL::shifted_slot_ratio() const
+{
+    if (word_offsets_.empty())
+        return 0;
+    size_t shifted = 0;
+    for (auto offset : word_offsets_)
+        shifted += offset != GATHER;
+    return (double)shifted / word_offsets_.size();
+}
+
+bool BinaryGOL::pack(const float* state)
+{
+    bool binary = true;
+#pragma omp parallel for reduction(&& : binary)
+    for (size_t w = 0; w < n_words_; w++)
+    {
+        uint64_t word = 0;
+        const size_t end = std::min<size_t>(64 * w + 64, n_faces_);
+        for (size_t f = 64 * w; f < end; f++)
+        {
+            binary = binary && (state[f] == 0.0f || state[f] == 1.0f);
+            word |= (uint64_t)(state[f] == 1.0f) << (f & 63);
+        }
+        bits_[w] = word;
+    }
+    return binary;
+}
+
+void BinaryGOL::unpack(float* state) const
+{
+#pragma omp parallel for
+    for (size_t f = 0; f < n_faces_; f++)
+        state[f] = alive(f) ? 1.0f : 0.0f;
+}
+
+void BinaryGOL::step(int num_steps, int lower, int upper)
+{
+    // bit c of the masks is set if a neighbor count of c leads to a living cell
+    uint64_t in_range_counts = 0, born_counts = 0;
+    for (int c = std::max(lower, 0); c <= std::min(upper, MAX_SLOTS); c++)
+        in_range_counts |= (uint64_t)1 << c;
+    if (upper >= 0 && upper <= MAX_SLOTS)
+        born_counts = (uint64_t)1 << upper;
+
+    for (int i = 0; i < num_steps; i++)
+    {
+        if (uses_slots())
+            step_slots(in_range_counts, born_counts);
+        else
+            step_gather(lower, upper);
+        std::swap(bits_, next_bits_);
+    }
+}
+
+void BinaryGOL::step_slots(uint64_t in_range_counts, uint64_t born_counts)
+{
+    const uint64_t* bits = bits_.data();
+    const uint32_t* slots = slots_.data();
+    const int32_t* word_offsets = word_offsets_.data();
+    const int n_slots = n_slots_;
+
+#pragma omp parallel for
+    for (size_t w = 0; w < n_words_; w++)
+    {
+        // collect the bits of slot k of all 64 faces of the word in neighbors[k]
+        uint64_t neighbors[MAX_SLOTS] = {};
+        const size_t begin = 64 * w;
+        const size_t end = std::min<size_t>(begin + 64, n_faces_);
+        const int32_t* offsets = word_offsets + w * n_slots;
+        bool gather = false;
+        for (int k = 0; k < n_slots; k++)
+        {
+            if (offsets[k] == GATHER)
+            {
+                gather = true;
+            }
+            else if (offsets[k] != EMPTY)
+            {
+                // bits begin + offset ... begin + offset + 63
+                const size_t first = begin + offsets[k];
+                const size_t shift = first & 63;
+                const uint64_t lo = bits[first >> 6] >> shift;
+                const uint64_t hi = shift ? bits[(first >> 6) + 1] << (64 - shift) : 0;
+                neighbors[k] = lo | hi;
+            }
+        }
+        if (gather)
+        {
+            for (size_t f = begin; f < end; f++)
+            {
+                const uint32_t* s = slots + f * n_slots;
+                for (int k = 0; k < n_slots; k++)
+                {
+                    if (offsets[k] == GATHER)
+                        neighbors[k] |= ((bits[s[k] >> 6] >> (s[k] & 63)) & 1) << (f & 63);
+                }
+            }
+        }
+
+        // bit-sliced addition, bit b of count[p] is bit p of the neighbor count of face begin + b
+        uint64_t count[4] = {};
+        for (int k = 0; k < n_slots; k++)
+        {
+            uint64_t carry = neighbors[k];
+            for (int p = 0; p < 4 && carry; p++)
+            {
+                const uint64_t t = count[p] & carry;
+                count[p] ^= carry;
+                carry = t;
+            }
+        }
+
+        uint64_t in_range = 0, born = 0;
+        for (int c = 0; c <= n_slots; c++)
+        {
+            if (!(((in_range_counts | born_counts) >> c) & 1))
+                continue;
+            uint64_t equal = ~(uint64_t)0;
+            for (int p = 0; p < 4; p++)
+                equal &= ((c >> p) & 1) ? count[p] : ~count[p];
+            if ((in_range_counts >> c) & 1)
+                in_range |= equal;
+            if ((born_counts >> c) & 1)
+                born |= equal;
+        }
+
+        // bits past the last face (including the always dead one) stay 0
+        const uint64_t valid = end - begin == 64 ? ~(uint64_t)0 : (((uint64_t)1 << (end - begin)) - 1);
+        const uint64_t alive = bits[w];
+        next_bits_[w] = ((alive & in_range) | (~alive & born)) & valid;
+    }
+}
+
+void BinaryGOL::step_gather(int lower, int upper)
+{
+    const uint64_t* bits = bits_.data();
+    const uint32_t* offsets = adjacency_->offsets.data();
+    const uint32_t* indices = adjacency_->indices.data();
+
+#pragma omp parallel for
+    for (size_t w = 0; w < n_words_; w++)
+    {
+        uint64_t word = 0;
+        const size_t end = std::min<size_t>(64 * w + 64, n_faces_);
+        for (size_t f = 64 * w; f < end; f++)
+        {
+            int num_alive = 0;
+            for (uint32_t j = offsets[f]; j < offsets[f + 1]; j++)
+                num_alive += (bits[indices[j] >> 6] >> (indices[j] & 63)) & 1;
+
+            const bool was_alive = (bits[w] >> (f & 63)) & 1;
+            const bool is_alive = was_alive ? (num_alive >= lower && num_alive <= upper) : (num_alive == upper);
+            word |= (uint64_t)is_alive << (f & 63);
+        }
+        next_bits_[w] = word;
+    }
+}
+
+} // namespace meshlife
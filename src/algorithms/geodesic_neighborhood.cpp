@@ -0,0 +1,357 @@
+#include "meshlife/algorithms/geodesic_neighborhood.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace meshlife
+{
+
+GeodesicNeighborhood::GeodesicNeighborhood(const pmp::SurfaceMesh& mesh) : mesh_(mesh)
+{
+    find_virtual_edges();
+}
+
+GeodesicNeighborhood::Scratch GeodesicNeighborhood::make_scratch() const
+{
+    Scratch scratch;
+    scratch.distance.assign(mesh_.vertices_size(), std::numeric_limits<pmp::Scalar>::max());
+    scratch.processed.assign(mesh_.vertices_size(), false);
+    return scratch;
+}
+
+// same as pmp::Geodesics::find_virtual_edges(), but stored per halfedge instead of in a map
+void GeodesicNeighborhood::find_virtual_edges()
+{
+    using pmp::Point;
+    using pmp::Scalar;
+    using pmp::vec2;
+
+    pmp::Halfedge hh, hhh;
+    pmp::Vertex vh0, vh1, vhn, start_vh0, start_vh1;
+    Point pp, p0, p1, pn, p, d0, d1;
+    Point X, Y;
+    vec2 v0, v1, vn, v, d;
+    Scalar f, alpha, beta, tan_beta;
+
+    const Scalar one(1.0), minus_one(-1.0);
+    const Scalar max_angle = 90.0 / 180.0 * M_PI;
+    const Scalar max_angle_cos = cos(max_angle);
+
+    virtual_edges_.clear();
+    virtual_edges_.resize(mesh_.halfedges_size());
+
+    for (auto vv : mesh_.vertices())
+    {
+        pp = mesh_.position(vv);
+
+        for (auto h : mesh_.halfedges(vv))
+        {
+            if (mesh_.is_boundary(h))
+                continue;
+
+            vh0 = mesh_.to_vertex(h);
+            hh = mesh_.next_halfedge(h);
+            vh1 = mesh_.to_vertex(hh);
+
+            p0 = mesh_.position(vh0);
+            p1 = mesh_.position(vh1);
+            d0 = normalize(p0 - pp);
+            d1 = normalize(p1 - pp);
+
+            // obtuse angle ?
+            if (dot(d0, d1) >= max_angle_cos)
+                continue;
+
+            // compute angles
+            alpha = 0.5 * acos(std::min(one, std::max(minus_one, dot(d0, d1))));
+            beta = max_angle - alpha;
+            tan_beta = tan(beta);
+
+            // coord system
+            X = normalize(d0 + d1);
+            Y = normalize(cross(cross(d0, d1), X));
+
+            // 2D coords
+            d0 = p0 - pp;
+            d1 = p1 - pp;
+            v0[0] = dot(d0, X);
+            v0[1] = dot(d0, Y);
+            v1[0] = dot(d1, X);
+            v1[1] = dot(d1, Y);
+
+            start_vh0 = vh0;
+            start_vh1 = vh1;
+            hhh = mesh_.opposite_halfedge(hh);
+
+            // unfold ...
+            while (((vh0 == start_vh0) || (vh1 == start_vh1)) && (!mesh_.is_boundary(hhh)))
+            {
+                // get next point
+                vhn = mesh_.to_vertex(mesh_.next_halfedge(hhh));
+                pn = mesh_.position(vhn);
+                d0 = (p1 - p0);
+                d1 = (pn - p0);
+                d = (v1 - v0);
+                f = dot(d0, d1) / sqrnorm(d0);
+                p = p0 + f * d0;
+                v = v0 + f * d;
+                d = normalize(vec2(d[1], -d[0]));
+                vn = v + d * norm(p - pn);
+
+                // point in tolerance?
+                if ((fabs(vn[1]) / fabs(vn[0])) < tan_beta)
+                {
+                    virtual_edges_[h.idx()].vertex = vhn;
+                    virtual_edges_[h.idx()].length = norm(vn);
+                    break;
+                }
+
+                // prepare next edge
+                if (vn[1] > 0.0)
+                {
+                    hh = mesh_.opposite_halfedge(hh);
+                    hh = mesh_.next_halfedge(hh);
+                    vh1 = vhn;
+                    p1 = pn;
+                    v1 = vn;
+                }
+                else
+                {
+                    hh = mesh_.opposite_halfedge(hh);
+                    hh = mesh_.next_halfedge(hh);
+                    hh = mesh_.next_halfedge(hh);
+                    vh0 = vhn;
+                    p0 = pn;
+                    v0 = vn;
+                }
+                hhh = mesh_.opposite_halfedge(hh);
+            }
+        }
+    }
+}
+
+void GeodesicNeighborhood::compute(const std::vector<pmp::Vertex>& seeds,
+                                   pmp::Scalar maxdist,
+                                   Scratch& scratch,
+                                   Neighbors& neighbors) const
+{
+    const auto by_distance = [](const std::pair<pmp::Vertex, pmp::Scalar>& a,
+                                const std::pair<pmp::Vertex, pmp::Scalar>& b)
+    { return (a.second == b.second) ? (a.first < b.first) : (a.second < b.second); };
+    const auto heap_cmp = std::greater<std::pair<pmp::Scalar, uint32_t>>();
+
+    neighbors.clear();
+    scratch.front.clear();
+
+    if (seeds.empty())
+        return;
+
+    // initialize seed vertices
+    for (auto v : seeds)
+    {
+        touch(v, scratch);
+        scratch.processed[v.idx()] = true;
+        scratch.distance[v.idx()] = 0.0;
+    }
+
+    // initialize seed's one-ring
+    for (auto v : seeds)
+    {
+        for (auto vv : mesh_.vertices(v))
+        {
+            const pmp::Scalar dist = pmp::distance(mesh_.position(v), mesh_.position(vv));
+            if (dist < scratch.distance[vv.idx()])
+            {
+                touch(vv, scratch);
+                scratch.distance[vv.idx()] = dist;
+                scratch.processed[vv.idx()] = true;
+                neighbors.emplace_back(vv, dist);
+            }
+        }
+    }
+
+    // sort one-ring neighbors of seed vertices
+    std::sort(neighbors.begin(), neighbors.end(), by_distance);
+
+    // init marching front
+    for (auto v : seeds)
+    {
+        for (auto vv : mesh_.vertices(v))
+        {
+            for (auto vvv : mesh_.vertices(vv))
+            {
+                if (!scratch.processed[vvv.idx()])
+                    heap_vertex(vvv, scratch);
+            }
+        }
+    }
+
+    // propagate up to max distance, the front may contain outdated entries which get skipped
+    while (!scratch.front.empty())
+    {
+        std::pop_heap(scratch.front.begin(), scratch.front.end(), heap_cmp);
+        const auto [dist, idx] = scratch.front.back();
+        scratch.front.pop_back();
+
+        if (scratch.processed[idx] || dist != scratch.distance[idx])
+            continue;
+
+        const pmp::Vertex v(idx);
+        scratch.processed[idx] = true;
+        neighbors.emplace_back(v, dist);
+
+        // did we reach maximum distance?
+        if (dist > maxdist)
+            break;
+
+        // update front
+        for (auto vv : mesh_.vertices(v))
+        {
+            if (!scratch.processed[vv.idx()])
+                heap_vertex(vv, scratch);
+        }
+    }
+
+    // local reset, only visit what this query touched
+    for (auto idx : scratch.touched)
+    {
+        scratch.distance[idx] = std::numeric_limits<pmp::Scalar>::max();
+        scratch.processed[idx] = false;
+    }
+    scratch.touched.clear();
+    scratch.front.clear();
+}
+
+void GeodesicNeighborhood::heap_vertex(pmp::Vertex v, Scratch& scratch) const
+{
+    pmp::Scalar dist, dist_min(std::numeric_limits<pmp::Scalar>::max());
+    bool found(false);
+
+    for (auto h : mesh_.halfedges(v))
+    {
+        if (mesh_.is_boundary(h))
+            continue;
+
+        const pmp::Vertex v0 = mesh_.to_vertex(h);
+        const pmp::Vertex v1 = mesh_.to_vertex(mesh_.next_halfedge(h));
+        const VirtualEdge& ve = virtual_edges_[h.idx()];
+
+        // no virtual edge
+        if (!ve.vertex.is_valid())
+        {
+            if (scratch.processed[v0.idx()] && scratch.processed[v1.idx()])
+            {
+                dist = distance(scratch, v0, v1, v);
+                if (dist < dist_min)
+                {
+                    dist_min = dist;
+                    found = true;
+                }
+            }
+        }
+
+        // virtual edge
+        else
+        {
+            if (scratch.processed[v0.idx()] && scratch.processed[ve.vertex.idx()])
+            {
+                dist = distance(scratch, v0, ve.vertex, v, std::numeric_limits<pmp::Scalar>::max(), ve.length);
+                if (dist < dist_min)
+                {
+                    dist_min = dist;
+                    found = true;
+                }
+            }
+
+            if (scratch.processed[v1.idx()] && scratch.processed[ve.vertex.idx()])
+            {
+                dist = distance(scratch, ve.vertex, v1, v, ve.length, std::numeric_limits<pmp::Scalar>::max());
+                if (dist < dist_min)
+                {
+                    dist_min = dist;
+                    found = true;
+                }
+            }
+        }
+    }
+
+    // update front (outdated entries stay in the heap and are skipped when popped)
+    if (found)
+    {
+        touch(v, scratch);
+        scratch.distance[v.idx()] = dist_min;
+        scratch.front.emplace_back(dist_min, v.idx());
+        std::push_heap(scratch.front.begin(), scratch.front.end(), std::greater<std::pair<pmp::Scalar, uint32_t>>());
+    }
+    else
+    {
+        scratch.distance[v.idx()] = std::numeric_limits<pmp::Scalar>::max();
+    }
+}
+
+// same as pmp::Geodesics::distance()
+pmp::Scalar GeodesicNeighborhood::distance(const Scratch& scratch,
+                                           pmp::Vertex v0,
+                                           pmp::Vertex v1,
+                                           pmp::Vertex v2,
+                                           pmp::Scalar r0,
+                                           pmp::Scalar r1) const
+{
+    pmp::Point A, B, C;
+    double TA, TB;
+    double a, b;
+
+    // choose points such that TB>TA and hence u>0
+    if (scratch.distance[v0.idx()] < scratch.distance[v1.idx()])
+    {
+        A = mesh_.position(v0);
+        B = mesh_.position(v1);
+        C = mesh_.position(v2);
+        TA = scratch.distance[v0.idx()];
+        TB = scratch.distance[v1.idx()];
+        a = r1 == std::numeric_limits<pmp::Scalar>::max() ? pmp::distance(B, C) : r1;
+        b = r0 == std::numeric_limits<pmp::Scalar>::max() ? pmp::distance(A, C) : r0;
+    }
+    else
+    {
+        A = mesh_.position(v1);
+        B = mesh_.position(v0);
+        C = mesh_.position(v2);
+        TA = scratch.distance[v1.idx()];
+        TB = scratch.distance[v0.idx()];
+        a = r0 == std::numeric_limits<pmp::Scalar>::max() ? pmp::distance(B, C) : r0;
+        b = r1 == std::numeric_limits<pmp::Scalar>::max() ? pmp::distance(A, C) : r1;
+    }
+
+    // Dijkstra: propagate along edges
+    const double dijkstra = std::min(TA + b, TB + a);
+
+    // obtuse angle -> fall back to Dijkstra
+    const double c = dot(normalize(A - C), normalize(B - C)); // cosine
+    if (c < 0.0)
+        return dijkstra;
+
+    // Kimmel: solve quadratic equation
+    const double u = TB - TA;
+    const double aa = a * a + b * b - 2.0 * a * b * c;
+    const double bb = 2.0 * b * u * (a * c - b);
+    const double cc = b * b * (u * u - a * a * (1.0 - c * c));
+    const double dd = bb * bb - 4.0 * aa * cc;
+    if (dd > 0.0)
+    {
+        const double t1 = (-bb + sqrt(dd)) / (2.0 * aa);
+        const double t2 = (-bb - sqrt(dd)) / (2.0 * aa);
+        const double t = std::max(t1, t2);
+        const double q = b * (t - u) / t;
+        if ((u < t) && (a * c < q) && (q < a / c))
+        {
+            return TA + t;
+        }
+    }
+
+    // use Dijkstra as fall-back
+    return dijkstra;
+}
+
+} // namespace meshlife
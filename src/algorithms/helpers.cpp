@@ -1,5 +1,12 @@
 #include "meshlife/algorithms/helpers.h"
 
+#include <pmp/algorithms/differential_geometry.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <limits>
+
 namespace meshlife
 {
 
@@ -26,6 +33,294 @@ std::set<pmp::Face> get_neighbored_faces(pmp::SurfaceMesh& mesh, pmp::Face f)
     return neighbored_faces;
 }
 
+namespace
+{
+
+// hands out the face order revisions, so two meshes (or a mesh loaded in place of another) never share one
+std::atomic<uint32_t> face_order_revisions{0};
+
+// name of the face property holding the face order revision of a mesh, every face stores the same value
+const char* FACE_ORDER_PROPERTY = "f:face_order";
+
+// collects the sorted, unique neighbors of face f into (reused) buffer
+void collect_neighbored_faces(const pmp::SurfaceMesh& mesh, pmp::Face f, std::vector<uint32_t>& neighbors)
+{
+    neighbors.clear();
+    if (mesh.is_deleted(f))
+        return;
+
+    for (auto v : mesh.vertices(f))
+    {
+        for (auto nf : mesh.faces(v))
+        {
+            if (nf != f)
+                neighbors.push_back(nf.idx());
+        }
+    }
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+}
+
+} // namespace
+
+FaceAdjacency build_face_adjacency(const pmp::SurfaceMesh& mesh)
+{
+    const size_t n = mesh.faces_size();
+
+    FaceAdjacency adjacency;
+    adjacency.offsets.assign(n + 1, 0);
+
+    // first pass: count neighbors per face
+#pragma omp parallel
+    {
+        std::vector<uint32_t> neighbors;
+#pragma omp for
+        for (size_t i = 0; i < n; i++)
+        {
+            collect_neighbored_faces(mesh, pmp::Face(i), neighbors);
+            adjacency.offsets[i + 1] = neighbors.size();
+        }
+    }
+
+    for (size_t i = 0; i < n; i++)
+        adjacency.offsets[i + 1] += adjacency.offsets[i];
+
+    // second pass: fill rows
+    adjacency.indices.resize(adjacency.offsets[n]);
+#pragma omp parallel
+    {
+        std::vector<uint32_t> neighbors;
+#pragma omp for
+        for (size_t i = 0; i < n; i++)
+        {
+            collect_neighbored_faces(mesh, pmp::Face(i), neighbors);
+            std::copy(neighbors.begin(), neighbors.end(), adjacency.indices.begin() + adjacency.offsets[i]);
+        }
+    }
+
+    return adjacency;
+}
+
+TopologyFingerprint topology_fingerprint(const pmp::SurfaceMesh& mesh)
+{
+    TopologyFingerprint fingerprint;
+    fingerprint.vertices_size = mesh.vertices_size();
+    fingerprint.halfedges_size = mesh.halfedges_size();
+    fingerprint.faces_size = mesh.faces_size();
+    fingerprint.n_faces = mesh.n_faces();
+    auto face_order = mesh.get_face_property<uint32_t>(FACE_ORDER_PROPERTY);
+    if (face_order && mesh.faces_size() > 0)
+        fingerprint.face_order = face_order[pmp::Face(0)];
+    return fingerprint;
+}
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t hash)
+{
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+namespace
+{
+
+template <typename T>
+void hash_value(uint64_t& hash, const T& value)
+{
+    hash = hash_bytes(&value, sizeof(T), hash);
+}
+
+} // namespace
+
+uint64_t connectivity_hash(const pmp::SurfaceMesh& mesh)
+{
+    uint64_t hash = HASH_SEED;
+    hash_value(hash, (uint64_t)mesh.n_vertices());
+    hash_value(hash, (uint64_t)mesh.n_faces());
+    for (auto f : mesh.faces())
+    {
+        hash_value(hash, (uint32_t)f.idx());
+        for (auto v : mesh.vertices(f))
+            hash_value(hash, (uint32_t)v.idx());
+    }
+    return hash;
+}
+
+uint64_t geometry_hash(const pmp::SurfaceMesh& mesh)
+{
+    uint64_t hash = connectivity_hash(mesh);
+    for (auto v : mesh.vertices())
+        hash_value(hash, mesh.position(v));
+    return hash;
+}
+
+pmp::Face nearest_face(const pmp::SurfaceMesh& mesh, const pmp::Point& p)
+{
+    pmp::Face nearest;
+    pmp::Scalar d, dmin(std::numeric_limits<pmp::Scalar>::max());
+    for (auto f : mesh.faces())
+    {
+        d = sqrnorm(pmp::centroid(mesh, f) - p);
+        if (d < dmin)
+        {
+            dmin = d;
+            nearest = f;
+        }
+    }
+    return nearest;
+}
+
+namespace
+{
+
+// spreads the lower 21 bits of x such that there are two zero bits between each
+uint64_t spread_bits(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffff;
+    x = (x | x << 16) & 0x1f0000ff0000ff;
+    x = (x | x << 8) & 0x100f00f00f00f00f;
+    x = (x | x << 4) & 0x10c30c30c30c30c3;
+    x = (x | x << 2) & 0x1249249249249249;
+    return x;
+}
+
+// applies the permutation to a face property if it has value type T, returns whether it has
+template <typename T>
+bool permute_face_property(pmp::SurfaceMesh& mesh,
+                           const std::string& name,
+                           const std::vector<uint32_t>& order,
+                           bool apply)
+{
+    auto prop = mesh.get_face_property<T>(name);
+    if (!prop)
+        return false;
+
+    if (apply)
+    {
+        auto& values = prop.vector();
+        const std::vector<T> old_values(values.begin(), values.end());
+        for (size_t i = 0; i < order.size(); i++)
+            values[i] = old_values[order[i]];
+    }
+    return true;
+}
+
+bool permute_face_property(pmp::SurfaceMesh& mesh,
+                           const std::string& name,
+                           const std::vector<uint32_t>& order,
+                           bool apply)
+{
+    return permute_face_property<float>(mesh, name, order, apply)
+           || permute_face_property<double>(mesh, name, order, apply)
+           || permute_face_property<int>(mesh, name, order, apply)
+           || permute_face_property<uint32_t>(mesh, name, order, apply)
+           || permute_face_property<bool>(mesh, name, order, apply)
+           || permute_face_property<pmp::vec2>(mesh, name, order, apply)
+           || permute_face_property<pmp::vec3>(mesh, name, order, apply)
+           || permute_face_property<pmp::dvec3>(mesh, name, order, apply);
+}
+
+} // namespace
+
+std::vector<uint32_t> morton_face_order(const pmp::SurfaceMesh& mesh)
+{
+    const size_t n = mesh.faces_size();
+    std::vector<pmp::Point> centroids(n);
+    std::vector<uint32_t> order;
+    order.reserve(mesh.n_faces());
+
+    pmp::Point bb_min(std::numeric_limits<pmp::Scalar>::max());
+    pmp::Point bb_max(-std::numeric_limits<pmp::Scalar>::max());
+    for (auto f : mesh.faces())
+    {
+        centroids[f.idx()] = pmp::centroid(mesh, f);
+        bb_min = min(bb_min, centroids[f.idx()]);
+        bb_max = max(bb_max, centroids[f.idx()]);
+        order.push_back(f.idx());
+    }
+    if (order.empty())
+        return order;
+
+    // quantize to 21 bits per axis on the (cubic) bounding box, keeps the curve isotropic
+    const pmp::Scalar extent = std::max(pmp::norm(bb_max - bb_min), std::numeric_limits<pmp::Scalar>::min());
+    const double scale = (double)((1 << 21) - 1) / extent;
+    std::vector<uint64_t> codes(n, 0);
+#pragma omp parallel for
+    for (size_t k = 0; k < order.size(); k++)
+    {
+        const uint32_t i = order[k];
+        const pmp::Point p = centroids[i] - bb_min;
+        codes[i] = spread_bits((uint64_t)(p[0] * scale)) | spread_bits((uint64_t)(p[1] * scale)) << 1
+                   | spread_bits((uint64_t)(p[2] * scale)) << 2;
+    }
+
+    std::sort(order.begin(), order.end(),
+              [&](uint32_t a, uint32_t b) { return codes[a] != codes[b] ? codes[a] < codes[b] : a < b; });
+    return order;
+}
+
+bool permute_faces(pmp::SurfaceMesh& mesh, const std::vector<uint32_t>& order)
+{
+    const size_t n = mesh.faces_size();
+    if (order.size() != n || mesh.n_faces() != n)
+        return false;
+
+    // new_index[old face] = new face
+    std::vector<uint32_t> new_index(n, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (order[i] >= n || new_index[order[i]] != n)
+            return false;
+        new_index[order[i]] = i;
+    }
+
+    // check all properties first, the mesh must not be left partially permuted
+    const auto properties = mesh.face_properties();
+    for (const auto& name : properties)
+    {
+        if (name != "f:connectivity" && !permute_face_property(mesh, name, order, false))
+        {
+            std::cerr << "Can not reorder faces, face property " << name << " has an unsupported type" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<pmp::Halfedge> face_halfedges(n);
+    for (size_t i = 0; i < n; i++)
+        face_halfedges[i] = mesh.halfedge(pmp::Face(order[i]));
+    for (size_t i = 0; i < n; i++)
+        mesh.set_halfedge(pmp::Face(i), face_halfedges[i]);
+
+    for (auto h : mesh.halfedges())
+    {
+        const pmp::Face f = mesh.face(h);
+        if (f.is_valid())
+            mesh.set_face(h, pmp::Face(new_index[f.idx()]));
+    }
+
+    for (const auto& name : properties)
+    {
+        if (name != "f:connectivity")
+            permute_face_property(mesh, name, order, true);
+    }
+
+    // invalidates everything cached by face index of this mesh, e.g. the tessellation and face ids of the MeshBuffers
+    auto face_order = mesh.face_property<uint32_t>(FACE_ORDER_PROPERTY, 0);
+    std::fill(face_order.vector().begin(), face_order.vector().end(), ++face_order_revisions);
+    return true;
+}
+
+bool reorder_faces_spatially(pmp::SurfaceMesh& mesh)
+{
+    mesh.garbage_collection();
+    return permute_faces(mesh, morton_face_order(mesh));
+}
+
 } // namespace helpers
 
 } // namespace meshlife
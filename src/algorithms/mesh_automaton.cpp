@@ -10,10 +10,11 @@ MeshAutomaton::MeshAutomaton(pmp::SurfaceMesh& mesh) : mesh_(mesh)
 
 void MeshAutomaton::allocate_needed_properties()
 {
-    if (!mesh_.has_face_property("f:state"))
+    // reuses the properties of a previous automaton on the same mesh
+    if (!state_ || !mesh_.has_face_property("f:state"))
     {
-        state_ = mesh_.add_face_property<float>("f:state", 0.0f);
-        last_state_ = mesh_.add_face_property<float>("f:last_state", 0.0f);
+        state_ = mesh_.face_property<float>("f:state", 0.0f);
+        last_state_ = mesh_.face_property<float>("f:last_state", 0.0f);
     }
 }
 
@@ -31,4 +32,16 @@ void MeshAutomaton::set_state(const pmp::Face& f, float value)
     state_[f] = value;
 }
 
+bool MeshAutomaton::publish_state(bool force)
+{
+    if (!force && !published_.consumed())
+        return false;
+
+    // the next step reads the state from last_state_ and GUI tools read state_, so the snapshot can not take over
+    // the property's storage. The buffers keep their capacity, so this does not allocate once all three have been used
+    published_.write_buffer().assign(state_.data(), state_.data() + mesh_.faces_size());
+    published_.publish();
+    return true;
+}
+
 } // namespace meshlife
@@ -7,7 +7,10 @@
 namespace meshlife
 {
 
-MeshGOL::MeshGOL(pmp::SurfaceMesh& mesh) : MeshAutomaton(mesh){};
+MeshGOL::MeshGOL(pmp::SurfaceMesh& mesh) : MeshAutomaton(mesh)
+{
+    precompute();
+};
 
 MeshGOL::~MeshGOL(){};
 
@@ -20,47 +23,73 @@ void MeshGOL::init_state_random()
     }
 };
 
+void MeshGOL::allocate_needed_properties()
+{
+    MeshAutomaton::allocate_needed_properties();
+    precompute();
+}
+
+void MeshGOL::precompute()
+{
+    adjacency_ = helpers::build_face_adjacency(mesh_);
+    adjacency_fingerprint_ = helpers::topology_fingerprint(mesh_);
+    binary_gol_.build(adjacency_);
+}
+
 void MeshGOL::update_state(int num_steps)
 {
     // conway's game of life for the faces of the mesh
 
+    // the mesh might have been modified (e.g. remeshed) without calling precompute()
+    if (helpers::topology_fingerprint(mesh_) != adjacency_fingerprint_)
+        precompute();
+
+    const size_t n_faces = adjacency_.size();
+    const uint32_t* offsets = adjacency_.offsets.data();
+    const uint32_t* indices = adjacency_.indices.data();
+    const int lower = p_lower_threshold_;
+    const int upper = p_upper_threshold_;
+
+    // the float states are only read and written once for all steps, which only pays off for many steps per call
+    if (p_bit_packed_ && binary_gol_.pack(state_.data()))
+    {
+        binary_gol_.step(num_steps, lower, upper);
+        binary_gol_.unpack(state_.vector().data());
+        return;
+    }
+
     for (int i = 0; i < num_steps; i++)
     {
-        // make copy of state_ to last_state_
-        for (pmp::Face f : mesh_.faces())
-        {
-            last_state_[f] = state_[f];
-        }
+        // the new state is computed from the last one, every face gets overwritten
+        swap_states();
 
-        for (auto f : mesh_.faces())
-        {
-            // get neighbored faces
-            auto neighbored_faces = helpers::get_neighbored_faces(mesh_, f);
+        const float* last = last_state_.data();
+        float* state = state_.vector().data();
 
+#pragma omp parallel for
+        for (size_t f = 0; f < n_faces; f++)
+        {
             // count number of alive neighbored faces
             int num_alive = 0;
-            for (auto nf : neighbored_faces)
+            for (uint32_t j = offsets[f]; j < offsets[f + 1]; j++)
             {
-                if (last_state_[nf] == 1.0f)
-                {
-                    num_alive++;
-                }
+                num_alive += (last[indices[j]] == 1.0f);
             }
 
             // Any live cell with two or three live neighbours survives
-            if (last_state_[f] == 1.0f && num_alive >= p_lower_threshold_ && num_alive <= p_upper_threshold_)
+            if (last[f] == 1.0f && num_alive >= lower && num_alive <= upper)
             {
-                state_[f] = 1.0f;
+                state[f] = 1.0f;
             }
             // Any dead cell with three live neighbours becomes a live cell
-            else if (last_state_[f] == 0.0f && num_alive == p_upper_threshold_)
+            else if (last[f] == 0.0f && num_alive == upper)
             {
-                state_[f] = 1.0f;
+                state[f] = 1.0f;
             }
             // All other live cells die in the next generation. Similarly, all other dead cells stay dead
             else
             {
-                state_[f] = 0.0f;
+                state[f] = 0.0f;
             }
         }
     }
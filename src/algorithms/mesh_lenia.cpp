@@ -1,9 +1,10 @@
 #include "meshlife/navigator.h"
 #include <iostream>
+#include <meshlife/algorithms/geodesic_neighborhood.h>
 #include <meshlife/algorithms/helpers.h>
 #include <meshlife/algorithms/mesh_lenia.h>
+#include <meshlife/algorithms/spatial_grid.h>
 #include <pmp/algorithms/differential_geometry.h>
-#include <pmp/algorithms/geodesics.h>
 #include <pmp/algorithms/utilities.h>
 #include <pmp/surface_mesh.h>
 #include <set>
@@ -11,10 +12,12 @@
 namespace meshlife
 {
 
-MeshLenia::MeshLenia(pmp::SurfaceMesh& mesh) : MeshAutomaton(mesh)
+MeshLenia::MeshLenia(pmp::SurfaceMesh& mesh, bool precache) : MeshAutomaton(mesh)
 {
     p_beta_peaks_ = {1, 1.0 / 3.0};
-    allocate_needed_properties();
+    average_edge_length_ = pmp::mean_edge_length(mesh_);
+    if (precache)
+        allocate_needed_properties();
 }
 
 void MeshLenia::allocate_needed_properties()
@@ -37,77 +40,92 @@ bool MeshLenia::is_closed_mesh()
 
 void MeshLenia::initialize_face_map_geodesic()
 {
+    // vertex i of the dual mesh is the centroid of face i
     pmp::SurfaceMesh dual_mesh(mesh_);
     pmp::dual(dual_mesh);
 
-#pragma omp parallel for
-    for (size_t i = 0; i < mesh_.faces_size(); i++)
-    {
-        pmp::SurfaceMesh m(dual_mesh);
-        pmp::Vertex v(i);
+    // shared by all threads, only the scratch memory is per thread
+    const GeodesicNeighborhood geodesics(dual_mesh);
 
-        std::vector<pmp::Vertex> start_vertices;
-        start_vertices.push_back(v);
-        std::vector<pmp::Vertex> neighbors;
-        pmp::geodesics(m, start_vertices, p_neighborhood_radius_, std::numeric_limits<int>::max(), &neighbors);
+    size_t neighbor_count = 0;
 
-        Neighbors final_neighbors;
+#pragma omp parallel reduction(+ : neighbor_count)
+    {
+        GeodesicNeighborhood::Scratch scratch = geodesics.make_scratch();
+        GeodesicNeighborhood::Neighbors neighbors;
+        std::vector<pmp::Vertex> start_vertices(1);
 
-        pmp::VertexProperty<float> distances = m.get_vertex_property<float>("geodesic:distance");
-        for (auto n : neighbors)
+#pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < mesh_.faces_size(); i++)
         {
-            // std::cout << "Distance: " << distances[n] << std::endl;
-            auto d = distances[n] / p_neighborhood_radius_;
-            if (d > 1)
+            start_vertices[0] = pmp::Vertex(i);
+            geodesics.compute(start_vertices, p_neighborhood_radius_, scratch, neighbors);
+
+            Neighbors final_neighbors;
+            final_neighbors.reserve(neighbors.size());
+
+            for (auto [n, distance] : neighbors)
             {
-                continue;
-            }
+                auto d = distance / p_neighborhood_radius_;
+                if (d > 1)
+                {
+                    continue;
+                }
 
-            final_neighbors.push_back(std::make_tuple(pmp::Face(n.idx()), d, 0));
-        }
+                final_neighbors.push_back(std::make_tuple(pmp::Face(n.idx()), d, 0));
+            }
 
-        neighbor_map_[i] = final_neighbors;
-#pragma omp critical
-        {
-            neighbor_count_avg_ += neighbors.size();
+            neighbor_count += final_neighbors.size();
+            neighbor_map_[i] = std::move(final_neighbors);
         }
     }
-    neighbor_count_avg_ /= neighbor_map_.size();
+    neighbor_count_avg_ = neighbor_count / std::max<size_t>(neighbor_map_.size(), 1);
 }
 
 void MeshLenia::initialize_face_map_euclidean()
 {
+    // centroids are needed many times per face, compute them once
+    std::vector<pmp::Point> centroids(mesh_.faces_size());
 #pragma omp parallel for
     for (size_t i = 0; i < mesh_.faces_size(); i++)
     {
-        const pmp::Face face = pmp::Face(i);
-        std::vector<Neighbor> neighbors;
-        neighbors.reserve(50);
+        centroids[i] = pmp::centroid(mesh_, pmp::Face(i));
+    }
 
-        const pmp::Point face_pos = pmp::centroid(mesh_, face);
+    const SpatialGrid grid(centroids, p_neighborhood_radius_);
+
+    size_t neighbor_count = 0;
+
+#pragma omp parallel reduction(+ : neighbor_count)
+    {
+        std::vector<uint32_t> candidates;
 
-        for (size_t j = 0; j < mesh_.faces_size(); j++)
+#pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < mesh_.faces_size(); i++)
         {
-            if (i == j)
-                continue;
+            std::vector<Neighbor> neighbors;
+
+            const pmp::Point& face_pos = centroids[i];
 
-            const pmp::Face neighbor = pmp::Face(j);
-            const pmp::Point neighbor_pos = pmp::centroid(mesh_, neighbor);
-            const float dist = pmp::distance(face_pos, neighbor_pos);
+            candidates.clear();
+            grid.query(face_pos, p_neighborhood_radius_, candidates);
+            neighbors.reserve(candidates.size());
 
-            if (dist <= p_neighborhood_radius_)
+            for (uint32_t j : candidates)
             {
+                if (i == j)
+                    continue;
+
+                const float dist = pmp::distance(face_pos, centroids[j]);
                 const float distance = dist / p_neighborhood_radius_;
-                neighbors.push_back(std::make_tuple(neighbor, distance, 0));
+                neighbors.push_back(std::make_tuple(pmp::Face(j), distance, 0));
             }
-        }
-        neighbor_map_[i] = neighbors;
-#pragma omp critical
-        {
-            neighbor_count_avg_ += neighbors.size();
+
+            neighbor_count += neighbors.size();
+            neighbor_map_[i] = std::move(neighbors);
         }
     }
-    neighbor_count_avg_ /= neighbor_map_.size();
+    neighbor_count_avg_ = neighbor_count / std::max<size_t>(neighbor_map_.size(), 1);
 }
 
 void MeshLenia::precache_face_values()
@@ -117,20 +135,37 @@ void MeshLenia::precache_face_values()
 
     mesh_.garbage_collection();
 
-    neighbor_map_.clear();
-    neighbor_map_.resize(mesh_.faces_size());
+    const bool geodesic = is_closed_mesh();
+    const uint64_t cache_key = p_neighborhood_cache_.empty() ? 0 : neighborhood_cache_key(geodesic);
+    const std::filesystem::path cache_file = neighborhood_cache_file(geodesic);
 
-    if (is_closed_mesh())
+    if (!cache_file.empty() && load_neighborhood_cache(cache_file, cache_key))
     {
-        std::cout << "Detected closed mesh. Using geodesic calculation." << std::endl;
-        initialize_face_map_geodesic();
+        std::cout << "Loaded neighborhoods from " << cache_file << std::endl;
     }
     else
     {
-        std::cout << "Detected open mesh. Using euclidean calculation." << std::endl;
-        initialize_face_map_euclidean();
+        neighbor_map_.clear();
+        neighbor_map_.resize(mesh_.faces_size());
+        neighbor_count_avg_ = 0;
+
+        if (geodesic)
+        {
+            std::cout << "Detected closed mesh. Using geodesic calculation." << std::endl;
+            initialize_face_map_geodesic();
+        }
+        else
+        {
+            std::cout << "Detected open mesh. Using euclidean calculation." << std::endl;
+            initialize_face_map_euclidean();
+        }
+        kernel_precompute();
+
+        if (!cache_file.empty() && save_neighborhood_cache(cache_file, cache_key))
+            std::cout << "Saved neighborhoods to " << cache_file << std::endl;
     }
-    kernel_precompute();
+    neighborhood_radius_computed_ = p_neighborhood_radius_;
+    neighborhood_fingerprint_ = helpers::topology_fingerprint(mesh_);
 
     auto time_end = std::chrono::high_resolution_clock::now();
 
@@ -147,29 +182,121 @@ void MeshLenia::precache_face_values()
     average_edge_length_ = pmp::mean_edge_length(mesh_);
 }
 
+void MeshLenia::update_neighborhood_radius()
+{
+    // neighbors beyond the computed radius are unknown, and a changed mesh invalidates all of them
+    if (p_neighborhood_radius_ > neighborhood_radius_computed_ || neighbor_map_.size() != mesh_.faces_size()
+        || neighborhood_fingerprint_ != helpers::topology_fingerprint(mesh_))
+    {
+        precache_face_values();
+        return;
+    }
+
+    if (p_neighborhood_radius_ < neighborhood_radius_computed_)
+        filter_neighborhoods(p_neighborhood_radius_);
+    kernel_precompute();
+}
+
+void MeshLenia::filter_neighborhoods(float radius)
+{
+    // the distances are stored relative to the computed radius, all neighbors within the smaller radius are in the
+    // lists already
+    const float scale = neighborhood_radius_computed_ / radius;
+    size_t neighbor_count = 0;
+
+#pragma omp parallel for schedule(dynamic, 256) reduction(+ : neighbor_count)
+    for (size_t i = 0; i < neighbor_map_.size(); i++)
+    {
+        Neighbors& neighbors = neighbor_map_[i];
+        size_t kept = 0;
+        for (size_t j = 0; j < neighbors.size(); j++)
+        {
+            const float d = std::get<1>(neighbors[j]) * scale;
+            if (!(d <= 1))
+                continue;
+            neighbors[kept] = std::make_tuple(std::get<0>(neighbors[j]), d, 0);
+            kept++;
+        }
+        neighbors.resize(kept);
+        neighbor_count += kept;
+    }
+
+    neighbor_count_avg_ = neighbor_count / std::max<size_t>(neighbor_map_.size(), 1);
+    neighborhood_radius_computed_ = radius;
+}
+
 void MeshLenia::kernel_precompute()
 {
     // ----- Kernel Precomputation -----
 
+    const size_t n_faces = neighbor_map_.size();
+
     kernel_shell_length_.clear();
-    kernel_shell_length_.resize(mesh_.faces_size());
+    kernel_shell_length_.resize(n_faces);
 
+    // areas are needed once per neighbor entry, compute them once per face
+    std::vector<float> face_areas(mesh_.faces_size(), 0.0f);
 #pragma omp parallel for
-    for (size_t i = 0; i < neighbor_map_.size(); i++)
+    for (size_t i = 0; i < mesh_.faces_size(); i++)
+    {
+        face_areas[i] = pmp::face_area(mesh_, pmp::Face(i));
+    }
+
+    kernel_.offsets.resize(n_faces + 1);
+    kernel_.offsets[0] = 0;
+    for (size_t i = 0; i < n_faces; i++)
+    {
+        kernel_.offsets[i + 1] = kernel_.offsets[i] + neighbor_map_[i].size();
+    }
+    kernel_.indices.resize(kernel_.offsets[n_faces]);
+    kernel_.weights.resize(kernel_.offsets[n_faces]);
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for (size_t i = 0; i < n_faces; i++)
     {
         float ksl = 0;
+        Neighbors& neighbors = neighbor_map_[i];
 
-        // std::cout << "Face: " << i << std::endl;
-        for (size_t j = 0; j < neighbor_map_[i].size(); j++)
+        for (size_t j = 0; j < neighbors.size(); j++)
         {
             float k_n = 0;
-            k_n = kernel_skeleton(std::get<1>(neighbor_map_[i][j]), p_beta_peaks_)
-                  * pmp::face_area(mesh_, std::get<0>(neighbor_map_[i][j]));
-            std::get<2>(neighbor_map_[i][j]) = k_n;
+            k_n = kernel_skeleton(std::get<1>(neighbors[j]), p_beta_peaks_)
+                  * face_areas[std::get<0>(neighbors[j]).idx()];
+            std::get<2>(neighbors[j]) = k_n;
             ksl += k_n;
         }
         kernel_shell_length_[i] = ksl;
+
+        // fold the normalization into the weights
+        const uint32_t row = kernel_.offsets[i];
+        for (size_t j = 0; j < neighbors.size(); j++)
+        {
+            kernel_.indices[row + j] = std::get<0>(neighbors[j]).idx();
+            kernel_.weights[row + j] = std::get<2>(neighbors[j]) / ksl;
+        }
     }
+
+    update_kernel_matrix();
+}
+
+void MeshLenia::update_kernel_matrix()
+{
+    // the matrix is either current or empty, update_state() assembles it on demand
+    if (p_backend_ == LeniaBackend::Eigen)
+        assemble_kernel_matrix();
+    else
+        kernel_matrix_ = KernelMatrix();
+}
+
+void MeshLenia::assemble_kernel_matrix()
+{
+    // same compressed row layout, so the arrays can be copied directly
+    const size_t n = kernel_.size();
+    kernel_matrix_ = KernelMatrix(n, n);
+    kernel_matrix_.resizeNonZeros(kernel_.indices.size());
+    std::copy(kernel_.offsets.begin(), kernel_.offsets.end(), kernel_matrix_.outerIndexPtr());
+    std::copy(kernel_.indices.begin(), kernel_.indices.end(), kernel_matrix_.innerIndexPtr());
+    std::copy(kernel_.weights.begin(), kernel_.weights.end(), kernel_matrix_.valuePtr());
 }
 
 void MeshLenia::update_state(int num_steps)
@@ -177,23 +304,50 @@ void MeshLenia::update_state(int num_steps)
 
     for (int step = 0; step < num_steps; step++)
     {
-        for (auto f : mesh_.faces())
-            last_state_[f] = state_[f];
+        // the new state is computed from the last one, every face gets overwritten
+        swap_states();
+
+        const float* last = last_state_.data();
+        float* state = state_.vector().data();
+        const simd::RowFunction row = simd::row_function(p_backend_);
+
+        const bool use_matrix = p_backend_ == LeniaBackend::Eigen;
+        if (use_matrix)
+        {
+            if ((size_t)kernel_matrix_.rows() != kernel_.size())
+                assemble_kernel_matrix();
+            potential_.noalias() = kernel_matrix_ * Eigen::Map<const Eigen::VectorXf>(last, kernel_.size());
+        }
 
 #pragma omp parallel for
-        for (size_t i = 0; i < mesh_.faces_size(); i++)
+        for (size_t i = 0; i < kernel_.size(); i++)
         {
-            const pmp::Face face = pmp::Face(i);
+            // faces without any (weighted) neighbor have no valid potential, set them to 0
+            if (kernel_shell_length_[i] == 0)
+            {
+                state[i] = 0;
+                continue;
+            }
+
             float new_state;
-            new_state = merged_together(face);
+            if (use_matrix)
+            {
+                new_state = potential_[i];
+            }
+            else
+            {
+                const uint32_t begin = kernel_.offsets[i];
+                new_state = row(kernel_.indices.data() + begin, kernel_.weights.data() + begin,
+                                kernel_.offsets[i + 1] - begin, last);
+            }
             new_state = growth(new_state, p_mu_, p_sigma_);
-            new_state = last_state_[face] + (1.0 / p_T_) * new_state;
+            new_state = last[i] + (1.0 / p_T_) * new_state;
             new_state = std::clamp<float>(new_state, 0.0, 1.0);
-            state_[face] = new_state;
-            // if a face does not have a neighbor/valid value, set it to 0
+            state[i] = new_state;
+            // if a face does not have a valid value, set it to 0
             if (new_state != new_state)
             {
-                state_[face] = 0;
+                state[i] = 0;
             }
         }
     }
@@ -224,12 +378,12 @@ float MeshLenia::exponential_kernel(float r, float a)
 }
 
 // One possible growth function G
-float MeshLenia::exponential_growth(float u, float m, float s)
+float MeshLenia::exponential_growth(float u, float m, float s) const
 {
     return 2.0 * exp(-(pow((u - m), 2.0) / (2.0 * pow(s, 2.0)))) - 1.0;
 }
 
-float MeshLenia::growth(float f, float m, float s)
+float MeshLenia::growth(float f, float m, float s) const
 {
     return exponential_growth(f, m, s);
 }
@@ -273,7 +427,7 @@ float MeshLenia::k(const Neighbor& n, const Neighbors& neighborhood)
 
 float MeshLenia::potential_distribution_u(const pmp::Face& x)
 {
-    Neighbors n = neighbor_map_[x.idx()];
+    const Neighbors& n = neighbor_map_[x.idx()];
     float sum = 0;
     for (auto neighbor : n)
     {
@@ -282,19 +436,17 @@ float MeshLenia::potential_distribution_u(const pmp::Face& x)
     return sum;
 }
 
-float MeshLenia::merged_together(const pmp::Face& x)
+float MeshLenia::merged_together(const pmp::Face& x) const
 {
-    Neighbors n = neighbor_map_[x.idx()];
-    float sum = 0;
+    const uint32_t* indices = kernel_.indices.data();
+    const float* weights = kernel_.weights.data();
+    const float* last = last_state_.data();
 
-    for (auto neighbor : n)
+    float sum = 0;
+    for (uint32_t j = kernel_.offsets[x.idx()]; j < kernel_.offsets[x.idx() + 1]; j++)
     {
-        // Load from cache
-        float k = std::get<2>(neighbor);
-        sum += k * last_state_[std::get<0>(neighbor)];
+        sum += weights[j] * last[indices[j]];
     }
-
-    sum = sum / kernel_shell_length_[x.idx()];
     return sum;
 }
 
@@ -479,7 +631,7 @@ float MeshLenia::norm_check()
 
 void MeshLenia::highlight_neighbors(pmp::Face& f)
 {
-    auto neighbors = neighbor_map_[f.idx()];
+    const Neighbors& neighbors = neighbor_map_[f.idx()];
 
     for (auto n : neighbors)
     {
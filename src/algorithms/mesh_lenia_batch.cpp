@@ -0,0 +1,94 @@
+#include "meshlife/algorithms/mesh_lenia_batch.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace meshlife
+{
+
+MeshLeniaBatch::MeshLeniaBatch(const MeshLenia& lenia, const std::vector<LeniaParameters>& parameters)
+    : lenia_(lenia), parameters_(parameters)
+{
+    state_.assign(faces() * lanes(), 0.0f);
+    last_state_.assign(faces() * lanes(), 0.0f);
+}
+
+void MeshLeniaBatch::init_state_random()
+{
+    for (auto& value : state_)
+    {
+        value = (float)rand() / RAND_MAX;
+    }
+}
+
+void MeshLeniaBatch::set_state(size_t lane, const pmp::FaceProperty<float>& prop)
+{
+    for (size_t i = 0; i < faces(); i++)
+    {
+        state_[i * lanes() + lane] = prop[pmp::Face(i)];
+    }
+}
+
+void MeshLeniaBatch::get_state(size_t lane, pmp::FaceProperty<float>& prop) const
+{
+    for (size_t i = 0; i < faces(); i++)
+    {
+        prop[pmp::Face(i)] = state_[i * lanes() + lane];
+    }
+}
+
+void MeshLeniaBatch::update_state(int num_steps)
+{
+    const LeniaKernel& kernel = lenia_.kernel();
+    const std::vector<float>& kernel_shell_length = lenia_.kernel_shell_lengths();
+    const size_t n_lanes = lanes();
+
+    for (int step = 0; step < num_steps; step++)
+    {
+        std::swap(state_, last_state_);
+        const float* last = last_state_.data();
+        float* state = state_.data();
+
+#pragma omp parallel
+        {
+            std::vector<float> potential(n_lanes);
+
+#pragma omp for schedule(dynamic, 64)
+            for (size_t i = 0; i < kernel.size(); i++)
+            {
+                float* out = state + i * n_lanes;
+
+                // faces without any (weighted) neighbor have no valid potential, set them to 0
+                if (kernel_shell_length[i] == 0)
+                {
+                    std::fill(out, out + n_lanes, 0.0f);
+                    continue;
+                }
+
+                // one gather of the neighbor's lanes per kernel entry
+                std::fill(potential.begin(), potential.end(), 0.0f);
+                for (uint32_t j = kernel.offsets[i]; j < kernel.offsets[i + 1]; j++)
+                {
+                    const float w = kernel.weights[j];
+                    const float* neighbor = last + (size_t)kernel.indices[j] * n_lanes;
+#pragma omp simd
+                    for (size_t l = 0; l < n_lanes; l++)
+                        potential[l] += w * neighbor[l];
+                }
+
+                for (size_t l = 0; l < n_lanes; l++)
+                {
+                    const LeniaParameters& p = parameters_[l];
+                    float new_state;
+                    new_state = lenia_.growth(potential[l], p.mu, p.sigma);
+                    new_state = last[i * n_lanes + l] + (1.0 / p.T) * new_state;
+                    new_state = std::clamp<float>(new_state, 0.0, 1.0);
+                    // if a face does not have a valid value, set it to 0
+                    out[l] = new_state != new_state ? 0 : new_state;
+                }
+            }
+        }
+    }
+}
+
+} // namespace meshlife
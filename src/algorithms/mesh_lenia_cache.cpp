@@ -0,0 +1,183 @@
+#include <meshlife/algorithms/helpers.h>
+#include <meshlife/algorithms/mesh_lenia.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace meshlife
+{
+
+namespace
+{
+
+/// Header of a neighborhood cache file. It is followed by the arrays offsets (n_faces_ + 1 x uint32), neighbor
+/// faces, neighbor distances and unnormalized kernel values (n_neighbors_ each, uint32 / float / float) and the kernel
+/// shell lengths (n_faces_ x float), in host byte order.
+struct NeighborhoodCacheHeader
+{
+    char magic_[8] = {'M', 'L', 'N', 'B', 'R', '1', '\0', '\0'};
+    uint64_t key_ = 0;
+    uint64_t n_faces_ = 0;
+    uint64_t n_neighbors_ = 0;
+};
+
+/// Changes whenever the file layout or the computation of the cached values changes, so old files are not used
+constexpr uint32_t CACHE_VERSION = 1;
+
+size_t cache_file_size(uint64_t n_faces, uint64_t n_neighbors)
+{
+    return sizeof(NeighborhoodCacheHeader) + (n_faces + 1) * sizeof(uint32_t)
+           + n_neighbors * (sizeof(uint32_t) + 2 * sizeof(float)) + n_faces * sizeof(float);
+}
+
+} // namespace
+
+uint64_t MeshLenia::neighborhood_cache_key(bool geodesic) const
+{
+    uint64_t hash = helpers::hash_bytes(&CACHE_VERSION, sizeof(CACHE_VERSION));
+    const uint64_t geometry = helpers::geometry_hash(mesh_);
+    hash = helpers::hash_bytes(&geometry, sizeof(geometry), hash);
+    hash = helpers::hash_bytes(&p_neighborhood_radius_, sizeof(p_neighborhood_radius_), hash);
+    const uint64_t n_peaks = p_beta_peaks_.size();
+    hash = helpers::hash_bytes(&n_peaks, sizeof(n_peaks), hash);
+    hash = helpers::hash_bytes(p_beta_peaks_.data(), n_peaks * sizeof(float), hash);
+    return helpers::hash_bytes(&geodesic, sizeof(geodesic), hash);
+}
+
+std::filesystem::path MeshLenia::neighborhood_cache_file(bool geodesic) const
+{
+    if (p_neighborhood_cache_.empty())
+        return {};
+
+    // the key is only stored in the file, so other radii or peaks replace it instead of adding files
+    return p_neighborhood_cache_.string() + (geodesic ? ".geodesic.neighbors" : ".euclidean.neighbors");
+}
+
+bool MeshLenia::load_neighborhood_cache(const std::filesystem::path& path, uint64_t key)
+{
+    // a missing file is the normal case before the first run
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    NeighborhoodCacheHeader header;
+    const NeighborhoodCacheHeader expected;
+    std::error_code error;
+    const size_t file_size = std::filesystem::file_size(path, error);
+    if (error || file_size < sizeof(header) || !file.read((char*)&header, sizeof(header))
+        || std::memcmp(header.magic_, expected.magic_, sizeof(expected.magic_)) != 0)
+    {
+        std::cerr << "Error: Ignoring invalid neighborhood cache " << path << std::endl;
+        return false;
+    }
+    // written for another radius, other peaks or another geometry, the computation replaces it
+    if (header.key_ != key)
+        return false;
+    if (header.n_faces_ != mesh_.faces_size() || file_size != cache_file_size(header.n_faces_, header.n_neighbors_))
+    {
+        std::cerr << "Error: Ignoring invalid neighborhood cache " << path << std::endl;
+        return false;
+    }
+
+    // the arrays are read straight into the kernel, the distances and kernel values only go into neighbor_map_
+    const size_t n_faces = header.n_faces_;
+    const size_t n_neighbors = header.n_neighbors_;
+    std::vector<float> distances(n_neighbors);
+    std::vector<float> kernel_values(n_neighbors);
+    kernel_.offsets.resize(n_faces + 1);
+    kernel_.indices.resize(n_neighbors);
+    kernel_shell_length_.resize(n_faces);
+    file.read((char*)kernel_.offsets.data(), (n_faces + 1) * sizeof(uint32_t));
+    file.read((char*)kernel_.indices.data(), n_neighbors * sizeof(uint32_t));
+    file.read((char*)distances.data(), n_neighbors * sizeof(float));
+    file.read((char*)kernel_values.data(), n_neighbors * sizeof(float));
+    file.read((char*)kernel_shell_length_.data(), n_faces * sizeof(float));
+
+    // the simulation indexes the state with these without further checks
+    bool valid = (bool)file && kernel_.offsets[0] == 0 && kernel_.offsets[n_faces] == n_neighbors;
+    for (size_t i = 0; valid && i < n_faces; i++)
+        valid = kernel_.offsets[i] <= kernel_.offsets[i + 1];
+    for (size_t j = 0; valid && j < n_neighbors; j++)
+        valid = kernel_.indices[j] < n_faces;
+    if (!valid)
+    {
+        std::cerr << "Error: Ignoring invalid neighborhood cache " << path << std::endl;
+        kernel_ = LeniaKernel();
+        kernel_shell_length_.clear();
+        return false;
+    }
+
+    neighbor_map_.clear();
+    neighbor_map_.resize(n_faces);
+    kernel_.weights.resize(n_neighbors);
+
+#pragma omp parallel for schedule(dynamic, 256)
+    for (size_t i = 0; i < n_faces; i++)
+    {
+        Neighbors& neighbors = neighbor_map_[i];
+        neighbors.reserve(kernel_.offsets[i + 1] - kernel_.offsets[i]);
+        for (uint32_t j = kernel_.offsets[i]; j < kernel_.offsets[i + 1]; j++)
+        {
+            neighbors.push_back(std::make_tuple(pmp::Face(kernel_.indices[j]), distances[j], kernel_values[j]));
+            // same division as in kernel_precompute()
+            kernel_.weights[j] = kernel_values[j] / kernel_shell_length_[i];
+        }
+    }
+    neighbor_count_avg_ = n_neighbors / std::max<size_t>(n_faces, 1);
+
+    update_kernel_matrix();
+    return true;
+}
+
+bool MeshLenia::save_neighborhood_cache(const std::filesystem::path& path, uint64_t key) const
+{
+    NeighborhoodCacheHeader header;
+    header.key_ = key;
+    header.n_faces_ = neighbor_map_.size();
+    header.n_neighbors_ = kernel_.indices.size();
+
+    std::vector<float> distances(header.n_neighbors_);
+    std::vector<float> kernel_values(header.n_neighbors_);
+    for (size_t i = 0; i < neighbor_map_.size(); i++)
+    {
+        for (size_t j = 0; j < neighbor_map_[i].size(); j++)
+        {
+            distances[kernel_.offsets[i] + j] = std::get<1>(neighbor_map_[i][j]);
+            kernel_values[kernel_.offsets[i] + j] = std::get<2>(neighbor_map_[i][j]);
+        }
+    }
+
+    // write to a temporary file first, so a viewer started meanwhile never maps a half written cache
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    std::error_code error;
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)kernel_.offsets.data(), kernel_.offsets.size() * sizeof(uint32_t));
+        file.write((const char*)kernel_.indices.data(), kernel_.indices.size() * sizeof(uint32_t));
+        file.write((const char*)distances.data(), distances.size() * sizeof(float));
+        file.write((const char*)kernel_values.data(), kernel_values.size() * sizeof(float));
+        file.write((const char*)kernel_shell_length_.data(), kernel_shell_length_.size() * sizeof(float));
+        file.close();
+        if (!file)
+        {
+            std::cerr << "Error: Could not write neighborhood cache " << temporary << std::endl;
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        std::cerr << "Error: Could not write neighborhood cache " << path << " (" << error.message() << ")"
+                  << std::endl;
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace meshlife
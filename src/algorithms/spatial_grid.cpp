@@ -0,0 +1,93 @@
+#include "meshlife/algorithms/spatial_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace meshlife
+{
+
+SpatialGrid::SpatialGrid(const std::vector<pmp::Point>& points, pmp::Scalar cell_size) : points_(points)
+{
+    pmp::Point bb_min(std::numeric_limits<pmp::Scalar>::max());
+    pmp::Point bb_max(-std::numeric_limits<pmp::Scalar>::max());
+    for (const auto& p : points_)
+    {
+        bb_min = min(bb_min, p);
+        bb_max = max(bb_max, p);
+    }
+    if (points_.empty())
+        bb_min = bb_max = pmp::Point(0);
+
+    // limit the number of cells to a small multiple of the number of points, very small radii would otherwise
+    // allocate a huge, almost empty grid
+    const pmp::Point extent = bb_max - bb_min;
+    const double max_cells = std::max<double>(8.0 * points_.size(), 1.0);
+    cell_size_ = std::max<pmp::Scalar>(cell_size, std::numeric_limits<pmp::Scalar>::min());
+    while ((std::floor(extent[0] / cell_size_) + 1) * (std::floor(extent[1] / cell_size_) + 1)
+               * (std::floor(extent[2] / cell_size_) + 1)
+           > max_cells)
+    {
+        cell_size_ *= 2;
+    }
+
+    origin_ = bb_min;
+    for (int axis = 0; axis < 3; axis++)
+        resolution_[axis] = (int)std::floor(extent[axis] / cell_size_) + 1;
+
+    // counting sort of the points by cell
+    const size_t n_cells = (size_t)resolution_[0] * resolution_[1] * resolution_[2];
+    std::vector<uint32_t> point_cells(points_.size());
+    cell_offsets_.assign(n_cells + 1, 0);
+    for (size_t i = 0; i < points_.size(); i++)
+    {
+        const auto& p = points_[i];
+        point_cells[i]
+            = cell_index(cell_coordinate(p[0], 0), cell_coordinate(p[1], 1), cell_coordinate(p[2], 2));
+        cell_offsets_[point_cells[i] + 1]++;
+    }
+    for (size_t c = 0; c < n_cells; c++)
+        cell_offsets_[c + 1] += cell_offsets_[c];
+
+    cell_points_.resize(points_.size());
+    std::vector<uint32_t> fill(cell_offsets_.begin(), cell_offsets_.end() - 1);
+    for (size_t i = 0; i < points_.size(); i++)
+        cell_points_[fill[point_cells[i]]++] = i;
+}
+
+int SpatialGrid::cell_coordinate(pmp::Scalar value, int axis) const
+{
+    const int c = (int)std::floor((value - origin_[axis]) / cell_size_);
+    return std::clamp(c, 0, resolution_[axis] - 1);
+}
+
+void SpatialGrid::query(const pmp::Point& p, pmp::Scalar radius, std::vector<uint32_t>& result) const
+{
+    const size_t first = result.size();
+
+    int lo[3], hi[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        lo[axis] = cell_coordinate(p[axis] - radius, axis);
+        hi[axis] = cell_coordinate(p[axis] + radius, axis);
+    }
+
+    for (int z = lo[2]; z <= hi[2]; z++)
+    {
+        for (int y = lo[1]; y <= hi[1]; y++)
+        {
+            // cells along x are contiguous in memory
+            const size_t begin = cell_offsets_[cell_index(lo[0], y, z)];
+            const size_t end = cell_offsets_[cell_index(hi[0], y, z) + 1];
+            for (size_t k = begin; k < end; k++)
+            {
+                const uint32_t idx = cell_points_[k];
+                if (pmp::distance(p, points_[idx]) <= radius)
+                    result.push_back(idx);
+            }
+        }
+    }
+
+    std::sort(result.begin() + first, result.end());
+}
+
+} // namespace meshlife
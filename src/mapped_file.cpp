@@ -0,0 +1,63 @@
+#include "meshlife/mapped_file.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace meshlife
+{
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        const int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+    if (st.st_size == 0)
+    {
+        ::close(fd);
+        errno = ENODATA;
+        return false;
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid without the descriptor
+    const int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        errno = error;
+        return false;
+    }
+
+    data_ = (const uint8_t*)data;
+    size_ = st.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_)
+        munmap((void*)data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+} // namespace meshlife
@@ -0,0 +1,455 @@
+#include "meshlife/mesh_buffers.h"
+#include "pmp/algorithms/normals.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace meshlife
+{
+
+void MeshBuffers::build(const pmp::SurfaceMesh& mesh, float crease_angle, bool use_colors)
+{
+    // get properties
+    auto vpos = mesh.get_vertex_property<pmp::Point>("v:point");
+    auto vcolor = mesh.get_vertex_property<pmp::Color>("v:color");
+    auto vtex = mesh.get_vertex_property<pmp::TexCoord>("v:tex");
+    auto htex = mesh.get_halfedge_property<pmp::TexCoord>("h:tex");
+    auto fcolor = mesh.get_face_property<pmp::Color>("f:color");
+
+    positions_.clear();
+    colors_.clear();
+    normals_.clear();
+    tex_coords_.clear();
+    corner_faces_.clear();
+    triangle_indices_.clear();
+    triangle_faces_.clear();
+
+    if (mesh.n_faces())
+        update_tessellation(mesh);
+
+    // smooth shaded faces share their vertices, unless a corner needs its own texture coordinate or face color
+    indexed_ = mesh.n_faces() && crease_angle > 170 && !htex && !(fcolor && !vcolor && use_colors);
+    if (indexed_)
+    {
+        build_indexed(mesh, use_colors);
+        return;
+    }
+
+    // index array for remapping vertex indices during duplication
+    std::vector<size_t> vertex_indices(mesh.vertices_size());
+
+    // produce arrays of points, normals, and texcoords
+    // (duplicate vertices to allow for flat shading)
+
+    // we have a mesh: fill arrays by looping over faces
+    if (mesh.n_faces())
+    {
+        // every face writes the corners of its cached triangles to its own range, so all arrays are allocated once
+        const size_t n_faces = mesh.faces_size();
+        const size_t n_corners = 3 * face_triangles_.size();
+        const bool has_tex_coords = htex || vtex;
+        const bool has_colors = (vcolor || fcolor) && use_colors;
+        positions_.resize(n_corners);
+        normals_.resize(n_corners);
+        corner_faces_.resize(n_corners);
+        // mesh vertex of every corner, to map the edges onto the duplicated vertices
+        std::vector<uint32_t> corner_vertex_indices(n_corners);
+        if (has_tex_coords)
+            tex_coords_.resize(n_corners);
+        if (has_colors)
+            colors_.resize(n_corners);
+
+        // precompute normals for easy cases
+        std::vector<pmp::Normal> face_normals;
+        std::vector<pmp::Normal> vertex_normals;
+        if (crease_angle < 1)
+        {
+            face_normals.resize(n_faces);
+#pragma omp parallel for schedule(static)
+            for (size_t i = 0; i < n_faces; i++)
+            {
+                if (!mesh.is_deleted(pmp::Face(i)))
+                    face_normals[i] = pmp::face_normal(mesh, pmp::Face(i));
+            }
+        }
+        else if (crease_angle > 170)
+        {
+            vertex_normals.resize(mesh.vertices_size());
+#pragma omp parallel for schedule(static)
+            for (size_t i = 0; i < mesh.vertices_size(); i++)
+            {
+                if (!mesh.is_deleted(pmp::Vertex(i)))
+                    vertex_normals[i] = pmp::vertex_normal(mesh, pmp::Vertex(i));
+            }
+        }
+
+        // convert from degrees to radians
+        const pmp::Scalar crease_angle_radians = crease_angle / 180.0 * M_PI;
+
+        // faces in parallel, corner_normal() for intermediate crease angles is by far the most expensive part
+#pragma omp parallel
+        {
+            // data per face (for all corners)
+            std::vector<pmp::Vertex> corner_vertices;
+            std::vector<pmp::vec3> corner_positions;
+            std::vector<pmp::vec3> corner_colors;
+            std::vector<pmp::vec3> corner_normals;
+            std::vector<pmp::vec2> corner_texcoords;
+
+#pragma omp for schedule(dynamic, 256)
+            for (size_t i = 0; i < n_faces; i++)
+            {
+                // deleted faces have no triangles
+                if (face_triangle_offsets_[i] == face_triangle_offsets_[i + 1])
+                    continue;
+                const pmp::Face f(i);
+
+                // collect corner positions and normals
+                corner_vertices.clear();
+                corner_positions.clear();
+                corner_colors.clear();
+                corner_normals.clear();
+                corner_texcoords.clear();
+
+                for (auto h : mesh.halfedges(f))
+                {
+                    const pmp::Vertex v = mesh.to_vertex(h);
+                    corner_vertices.push_back(v);
+                    corner_positions.push_back((pmp::vec3)vpos[v]);
+
+                    if (crease_angle < 1)
+                    {
+                        corner_normals.push_back((pmp::vec3)face_normals[i]);
+                    }
+                    else if (crease_angle > 170)
+                    {
+                        corner_normals.push_back((pmp::vec3)vertex_normals[v.idx()]);
+                    }
+                    else
+                    {
+                        corner_normals.push_back((pmp::vec3)corner_normal(mesh, h, crease_angle_radians));
+                    }
+
+                    if (htex)
+                    {
+                        corner_texcoords.push_back((pmp::vec2)htex[h]);
+                    }
+                    else if (vtex)
+                    {
+                        corner_texcoords.push_back((pmp::vec2)vtex[v]);
+                    }
+
+                    if (vcolor && use_colors)
+                    {
+                        corner_colors.push_back((pmp::vec3)vcolor[v]);
+                    }
+                    else if (fcolor && use_colors)
+                    {
+                        corner_colors.push_back((pmp::vec3)fcolor[f]);
+                    }
+                }
+                assert(corner_vertices.size() >= 3);
+
+                // copy the corners of the cached triangles
+                size_t c = 3 * face_triangle_offsets_[i];
+                for (uint32_t t = face_triangle_offsets_[i]; t < face_triangle_offsets_[i + 1]; t++)
+                {
+                    for (int k = 0; k < 3; k++, c++)
+                    {
+                        const int corner = face_triangles_[t][k];
+                        positions_[c] = corner_positions[corner];
+                        normals_[c] = corner_normals[corner];
+                        if (has_tex_coords)
+                            tex_coords_[c] = corner_texcoords[corner];
+                        if (has_colors)
+                            colors_[c] = corner_colors[corner];
+                        corner_faces_[c] = i;
+                        corner_vertex_indices[c] = corner_vertices[corner].idx();
+                    }
+                }
+            }
+        }
+
+        // the edges use the last copy of each vertex
+        for (size_t c = 0; c < n_corners; c++)
+            vertex_indices[corner_vertex_indices[c]] = c;
+    }
+
+    // we have a point cloud
+    else if (mesh.n_vertices())
+    {
+        auto position = mesh.get_vertex_property<pmp::Point>("v:point");
+        if (position)
+        {
+            positions_.reserve(mesh.n_vertices());
+            for (auto v : mesh.vertices())
+                positions_.push_back((pmp::vec3)position[v]);
+        }
+
+        auto normals = mesh.get_vertex_property<pmp::Point>("v:normal");
+        if (normals)
+        {
+            normals_.reserve(mesh.n_vertices());
+            for (auto v : mesh.vertices())
+                normals_.push_back((pmp::vec3)normals[v]);
+        }
+
+        if (vcolor && use_colors)
+        {
+            colors_.reserve(mesh.n_vertices());
+            for (auto v : mesh.vertices())
+                colors_.push_back((pmp::vec3)vcolor[v]);
+        }
+    }
+
+    // edge indices
+    edge_indices_.clear();
+    edge_indices_.reserve(2 * mesh.n_edges());
+    for (auto e : mesh.edges())
+    {
+        auto v0 = mesh.vertex(e, 0).idx();
+        auto v1 = mesh.vertex(e, 1).idx();
+        edge_indices_.push_back(vertex_indices[v0]);
+        edge_indices_.push_back(vertex_indices[v1]);
+    }
+
+    // feature edges
+    feature_indices_.clear();
+    auto efeature = mesh.get_edge_property<bool>("e:feature");
+    if (efeature)
+    {
+        for (auto e : mesh.edges())
+        {
+            if (efeature[e])
+            {
+                auto v0 = mesh.vertex(e, 0).idx();
+                auto v1 = mesh.vertex(e, 1).idx();
+                feature_indices_.push_back(vertex_indices[v0]);
+                feature_indices_.push_back(vertex_indices[v1]);
+            }
+        }
+    }
+}
+
+void MeshBuffers::build_indexed(const pmp::SurfaceMesh& mesh, bool use_colors)
+{
+    auto vpos = mesh.get_vertex_property<pmp::Point>("v:point");
+    auto vcolor = mesh.get_vertex_property<pmp::Color>("v:color");
+    auto vtex = mesh.get_vertex_property<pmp::TexCoord>("v:tex");
+
+    // deleted vertices keep their slot, they are never referenced
+    const size_t n_vertices = mesh.vertices_size();
+    positions_.resize(n_vertices);
+    normals_.resize(n_vertices);
+    if (vtex)
+        tex_coords_.resize(n_vertices);
+    if (vcolor && use_colors)
+        colors_.resize(n_vertices);
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n_vertices; i++)
+    {
+        const pmp::Vertex v(i);
+        if (mesh.is_deleted(v))
+            continue;
+        positions_[i] = (pmp::vec3)vpos[v];
+        normals_[i] = (pmp::vec3)pmp::vertex_normal(mesh, v);
+        if (vtex)
+            tex_coords_[i] = (pmp::vec2)vtex[v];
+        if (vcolor && use_colors)
+            colors_[i] = (pmp::vec3)vcolor[v];
+    }
+
+    // triangles stay in face order, which keeps the post-transform vertex cache warm for spatially sorted meshes
+    const size_t n_faces = mesh.faces_size();
+    triangle_indices_.resize(3 * face_triangles_.size());
+    triangle_faces_.resize(face_triangles_.size());
+#pragma omp parallel
+    {
+        std::vector<uint32_t> corner_vertices;
+#pragma omp for schedule(dynamic, 256)
+        for (size_t i = 0; i < n_faces; i++)
+        {
+            if (face_triangle_offsets_[i] == face_triangle_offsets_[i + 1])
+                continue;
+
+            corner_vertices.clear();
+            for (auto h : mesh.halfedges(pmp::Face(i)))
+                corner_vertices.push_back(mesh.to_vertex(h).idx());
+
+            for (uint32_t t = face_triangle_offsets_[i]; t < face_triangle_offsets_[i + 1]; t++)
+            {
+                triangle_indices_[3 * t] = corner_vertices[face_triangles_[t][0]];
+                triangle_indices_[3 * t + 1] = corner_vertices[face_triangles_[t][1]];
+                triangle_indices_[3 * t + 2] = corner_vertices[face_triangles_[t][2]];
+                triangle_faces_[t] = i;
+            }
+        }
+    }
+
+    // edges index the mesh vertices directly
+    edge_indices_.clear();
+    edge_indices_.reserve(2 * mesh.n_edges());
+    for (auto e : mesh.edges())
+    {
+        edge_indices_.push_back(mesh.vertex(e, 0).idx());
+        edge_indices_.push_back(mesh.vertex(e, 1).idx());
+    }
+
+    feature_indices_.clear();
+    auto efeature = mesh.get_edge_property<bool>("e:feature");
+    if (efeature)
+    {
+        for (auto e : mesh.edges())
+        {
+            if (efeature[e])
+            {
+                feature_indices_.push_back(mesh.vertex(e, 0).idx());
+                feature_indices_.push_back(mesh.vertex(e, 1).idx());
+            }
+        }
+    }
+}
+
+void MeshBuffers::update_tessellation(const pmp::SurfaceMesh& mesh)
+{
+    const helpers::TopologyFingerprint fingerprint = helpers::topology_fingerprint(mesh);
+    if (tessellation_revision_ == geometry_revision_ && tessellation_fingerprint_ == fingerprint)
+        return;
+
+    auto vpos = mesh.get_vertex_property<pmp::Point>("v:point");
+    const size_t n_faces = mesh.faces_size();
+
+    // first pass: a polygon with n corners always gets n - 2 triangles, deleted faces get an empty range
+    face_triangle_offsets_.assign(n_faces + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n_faces; i++)
+    {
+        if (!mesh.is_deleted(pmp::Face(i)))
+            face_triangle_offsets_[i + 1] = mesh.valence(pmp::Face(i)) - 2;
+    }
+
+    for (size_t i = 0; i < n_faces; i++)
+        face_triangle_offsets_[i + 1] += face_triangle_offsets_[i];
+
+    // second pass: tessellate the faces into their ranges
+    face_triangles_.resize(face_triangle_offsets_[n_faces]);
+#pragma omp parallel
+    {
+        Tessellator tessellator;
+        std::vector<pmp::vec3> corner_positions;
+        std::vector<pmp::ivec3> triangles;
+#pragma omp for schedule(dynamic, 256)
+        for (size_t i = 0; i < n_faces; i++)
+        {
+            if (face_triangle_offsets_[i] == face_triangle_offsets_[i + 1])
+                continue;
+
+            corner_positions.clear();
+            for (auto h : mesh.halfedges(pmp::Face(i)))
+                corner_positions.push_back((pmp::vec3)vpos[mesh.to_vertex(h)]);
+
+            tessellator.tesselate(corner_positions, triangles);
+            assert(triangles.size() == face_triangle_offsets_[i + 1] - face_triangle_offsets_[i]);
+            std::copy(triangles.begin(), triangles.end(), face_triangles_.begin() + face_triangle_offsets_[i]);
+        }
+    }
+
+    tessellation_revision_ = geometry_revision_;
+    tessellation_fingerprint_ = fingerprint;
+}
+
+// triangulate a polygon such that the sum of squared triangle areas is minimized.
+// this prevents overlapping/folding triangles for non-convex polygons.
+void MeshBuffers::Tessellator::tesselate(const std::vector<pmp::vec3>& points, std::vector<pmp::ivec3>& triangles)
+{
+    const int n = points.size();
+
+    triangles.clear();
+    triangles.reserve(n - 2);
+
+    // triangle? nothing to do
+    if (n == 3)
+    {
+        triangles.emplace_back(0, 1, 2);
+        return;
+    }
+
+    // quad? simply compare to two options
+    if (n == 4)
+    {
+        if (area(points[0], points[1], points[2]) + area(points[0], points[2], points[3])
+            < area(points[0], points[1], points[3]) + area(points[1], points[2], points[3]))
+        {
+            triangles.emplace_back(0, 1, 2);
+            triangles.emplace_back(0, 2, 3);
+        }
+        else
+        {
+            triangles.emplace_back(0, 1, 3);
+            triangles.emplace_back(1, 2, 3);
+        }
+        return;
+    }
+
+    // n-gon with n>4? compute triangulation by dynamic programming
+    init_triangulation(n);
+    int i, j, m, k, imin;
+    pmp::Scalar w, wmin;
+
+    // initialize 2-gons
+    for (i = 0; i < n - 1; ++i)
+    {
+        triangulation(i, i + 1) = Triangulation(0.0, -1);
+    }
+
+    // n-gons with n>2
+    for (j = 2; j < n; ++j)
+    {
+        // for all n-gons [i,i+j]
+        for (i = 0; i < n - j; ++i)
+        {
+            k = i + j;
+
+            wmin = std::numeric_limits<pmp::Scalar>::max();
+            imin = -1;
+
+            // find best split i < m < i+j
+            for (m = i + 1; m < k; ++m)
+            {
+                w = triangulation(i, m).area_ + area(points[i], points[m], points[k]) + triangulation(m, k).area_;
+
+                if (w < wmin)
+                {
+                    wmin = w;
+                    imin = m;
+                }
+            }
+
+            triangulation(i, k) = Triangulation(wmin, imin);
+        }
+    }
+
+    // build triangles from triangulation table
+    std::vector<pmp::ivec2> todo;
+    todo.reserve(n);
+    todo.emplace_back(0, n - 1);
+    while (!todo.empty())
+    {
+        pmp::ivec2 tri = todo.back();
+        todo.pop_back();
+        int start = tri[0];
+        int end = tri[1];
+        if (end - start < 2)
+            continue;
+        int split = triangulation(start, end).split_;
+
+        triangles.emplace_back(start, split, end);
+
+        todo.emplace_back(start, split);
+        todo.emplace_back(split, end);
+    }
+}
+
+} // namespace meshlife
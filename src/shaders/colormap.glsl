@@ -0,0 +1,65 @@
+// Colormaps of the automaton state, spliced into phong.frag and reflective_sphere.frag by the CustomRenderer where
+// they contain #include "colormap.glsl". Expects the colormap, use_triangle_faces and triangle_faces uniforms and the
+// v2f_face_id input to be declared before.
+
+// values of meshlife::Colormap
+const int COLORMAP_RAINBOW   = 0;
+const int COLORMAP_VIRIDIS   = 1;
+const int COLORMAP_INFERNO   = 2;
+const int COLORMAP_GRAYSCALE = 3;
+
+// hue from the clamped state, saturation from the state itself, like the former CPU coloring
+vec3 rainbow(float s)
+{
+    float h = mod(floor(clamp(s, 0.0, 1.0) * 360.0 + 270.0), 360.0);
+    float c = s;
+    float x = c * (1.0 - abs(mod(h / 60.0, 2.0) - 1.0));
+    vec3 rgb;
+    if      (h <  60.0) rgb = vec3(c, x, 0.0);
+    else if (h < 120.0) rgb = vec3(x, c, 0.0);
+    else if (h < 180.0) rgb = vec3(0.0, c, x);
+    else if (h < 240.0) rgb = vec3(0.0, x, c);
+    else if (h < 300.0) rgb = vec3(x, 0.0, c);
+    else                rgb = vec3(c, 0.0, x);
+    return rgb + (1.0 - c);
+}
+
+// polynomial fits of the matplotlib colormaps (by Matt Zucker, CC0)
+vec3 viridis(float t)
+{
+    const vec3 c0 = vec3(0.2777273272234177, 0.005407344544966578, 0.3340998053353061);
+    const vec3 c1 = vec3(0.1050930431085774, 1.404613529898575, 1.384590162594685);
+    const vec3 c2 = vec3(-0.3308618287255563, 0.214847559468213, 0.09509516302823659);
+    const vec3 c3 = vec3(-4.634230498983486, -5.799100973351585, -19.33244095627987);
+    const vec3 c4 = vec3(6.228269936347081, 14.17993336680509, 56.69055260068105);
+    const vec3 c5 = vec3(4.776384997670288, -13.74514537774601, -65.35303263337234);
+    const vec3 c6 = vec3(-5.435455855934631, 4.645852612178535, 26.3124352495832);
+    return c0 + t * (c1 + t * (c2 + t * (c3 + t * (c4 + t * (c5 + t * c6)))));
+}
+
+vec3 inferno(float t)
+{
+    const vec3 c0 = vec3(0.0002189403691192265, 0.001651004631001012, -0.01948089843709184);
+    const vec3 c1 = vec3(0.1065134194856116, 0.5639564367884091, 3.932712388889277);
+    const vec3 c2 = vec3(11.60249308247187, -3.972853965665698, -15.9423941062914);
+    const vec3 c3 = vec3(-41.70399613139459, 17.43639888205313, 44.35414519872813);
+    const vec3 c4 = vec3(77.162935699427, -33.40235894210092, -81.80730925738993);
+    const vec3 c5 = vec3(-71.31942824499214, 32.62606426397723, 73.20951985803202);
+    const vec3 c6 = vec3(25.13112622477341, -12.24266895238567, -23.07032500287172);
+    return c0 + t * (c1 + t * (c2 + t * (c3 + t * (c4 + t * (c5 + t * c6)))));
+}
+
+// indexed meshes share vertices between faces, their triangles know the face instead
+int face_id()
+{
+    return use_triangle_faces ? int(texelFetch(triangle_faces, gl_PrimitiveID).r) : int(v2f_face_id);
+}
+
+vec3 map_state(float s)
+{
+    float t = clamp(s, 0.0, 1.0);
+    if (colormap == COLORMAP_VIRIDIS)   return viridis(t);
+    if (colormap == COLORMAP_INFERNO)   return inferno(t);
+    if (colormap == COLORMAP_GRAYSCALE) return vec3(t);
+    return rainbow(s);
+}
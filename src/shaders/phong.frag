@@ -6,11 +6,15 @@ in vec3  v2f_normal;
 in vec2  v2f_tex;
 in vec3  v2f_view;
 in vec3  v2f_color;
+flat in uint v2f_face_id;
 
 uniform bool   use_lighting;
 uniform bool   use_texture;
 uniform bool   use_srgb;
 uniform bool   use_vertex_color;
+uniform bool   use_face_state;
+uniform bool   use_triangle_faces;
+uniform int    colormap;
 uniform vec3   front_color;
 uniform vec3   back_color;
 uniform float  ambient;
@@ -23,11 +27,20 @@ uniform vec3   light2;
 
 uniform sampler2D mytexture;
 
+uniform samplerBuffer face_state;
+uniform usamplerBuffer triangle_faces;
+
 out vec4 f_color;
 
+#include "colormap.glsl"
+
 void main()
 {
-    vec3 color = use_vertex_color ? v2f_color : (gl_FrontFacing ? front_color : back_color);
+    vec3 color;
+    if (use_face_state)
+        color = map_state(texelFetch(face_state, face_id()).r);
+    else
+        color = use_vertex_color ? v2f_color : (gl_FrontFacing ? front_color : back_color);
 
     vec3 rgb;
 
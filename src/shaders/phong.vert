@@ -4,11 +4,13 @@ layout (location=0) in vec4 v_position;
 layout (location=1) in vec3 v_normal;
 layout (location=2) in vec2 v_tex;
 layout (location=3) in vec3 v_color;
+layout (location=4) in uint v_face_id;
 
 out vec3 v2f_normal;
 out vec2 v2f_tex;
 out vec3 v2f_view;
 out vec3 v2f_color;
+flat out uint v2f_face_id;
 
 uniform mat4 modelview_projection_matrix;
 uniform mat4 modelview_matrix;
@@ -23,6 +25,7 @@ void main()
     vec4 pos     = show_texture_layout ? vec4(v_tex, 0.0, 1.0) : v_position;
     v2f_view     = -(modelview_matrix * pos).xyz;
     v2f_color    = v_color;
+    v2f_face_id  = v_face_id;
     gl_PointSize = point_size;
     gl_Position  = modelview_projection_matrix * pos;
 }
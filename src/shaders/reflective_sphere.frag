@@ -7,6 +7,7 @@ in vec3  v2f_normal;
 in vec2  v2f_tex;
 in vec3  v2f_view;
 in vec3  v2f_color;
+flat in uint v2f_face_id;
 in vec4  v2f_pos;
 
 uniform float reflectiveness;
@@ -15,6 +16,9 @@ uniform bool   use_lighting;
 uniform bool   use_texture;
 uniform bool   use_srgb;
 uniform bool   use_vertex_color;
+uniform bool   use_face_state;
+uniform bool   use_triangle_faces;
+uniform int    colormap;
 uniform vec3   front_color;
 uniform vec3   back_color;
 uniform float  ambient;
@@ -35,13 +39,28 @@ uniform float iTime;
 uniform samplerCube cubetexture;
 
 
+uniform samplerBuffer face_state;
+uniform usamplerBuffer triangle_faces;
+
 out vec4 f_color;
 
+#include "colormap.glsl"
+
 void main()
 {
-    vec3 color = use_vertex_color ? v2f_color : (gl_FrontFacing ? front_color : back_color);
-
-	float alive = color == vec3(1.0, 1.0, 1.0) ? 0.0 : 1.0;
+    vec3 color;
+    float alive;
+    if (use_face_state)
+    {
+        float state = texelFetch(face_state, face_id()).r;
+        color = map_state(state);
+        alive = state > 0.0 ? 1.0 : 0.0;
+    }
+    else
+    {
+        color = use_vertex_color ? v2f_color : (gl_FrontFacing ? front_color : back_color);
+        alive = color == vec3(1.0, 1.0, 1.0) ? 0.0 : 1.0;
+    }
 
     vec3 rgb;
 
@@ -0,0 +1,364 @@
+#include "meshlife/trajectory.h"
+#include "meshlife/algorithms/helpers.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace meshlife
+{
+
+static_assert(sizeof(TrajectoryHeader) == 48, "the header is written as is and must not contain padding");
+static_assert(sizeof(TrajectoryFrameHeader) == 24, "the frame header is written as is and must not contain padding");
+
+namespace
+{
+
+size_t encoded_size(TrajectoryEncoding encoding, size_t n_faces)
+{
+    switch (encoding)
+    {
+    case TrajectoryEncoding::Float32:
+        return n_faces * sizeof(float);
+    case TrajectoryEncoding::UInt8:
+        return n_faces;
+    case TrajectoryEncoding::Bits:
+        return (n_faces + 7) / 8;
+    }
+    return 0;
+}
+
+void encode_state(TrajectoryEncoding encoding, const float* state, size_t n_faces, std::vector<uint8_t>& out)
+{
+    out.assign(encoded_size(encoding, n_faces), 0);
+    switch (encoding)
+    {
+    case TrajectoryEncoding::Float32:
+        std::memcpy(out.data(), state, n_faces * sizeof(float));
+        break;
+    case TrajectoryEncoding::UInt8:
+        for (size_t i = 0; i < n_faces; i++)
+            out[i] = (uint8_t)std::lround(std::clamp(state[i], 0.0f, 1.0f) * 255.0f);
+        break;
+    case TrajectoryEncoding::Bits:
+        for (size_t i = 0; i < n_faces; i++)
+            if (state[i] >= 0.5f)
+                out[i / 8] |= 1 << (i % 8);
+        break;
+    }
+}
+
+void decode_state(TrajectoryEncoding encoding, const std::vector<uint8_t>& in, size_t n_faces,
+                  std::vector<float>& state)
+{
+    state.resize(n_faces);
+    switch (encoding)
+    {
+    case TrajectoryEncoding::Float32:
+        std::memcpy(state.data(), in.data(), n_faces * sizeof(float));
+        break;
+    case TrajectoryEncoding::UInt8:
+        for (size_t i = 0; i < n_faces; i++)
+            state[i] = in[i] / 255.0f;
+        break;
+    case TrajectoryEncoding::Bits:
+        for (size_t i = 0; i < n_faces; i++)
+            state[i] = (in[i / 8] >> (i % 8)) & 1 ? 1.0f : 0.0f;
+        break;
+    }
+}
+
+void put_varint(std::vector<uint8_t>& out, size_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+bool get_varint(const uint8_t*& p, const uint8_t* end, size_t& value)
+{
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        const uint8_t byte = *p++;
+        value |= (size_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/// Stores \p in as pairs of (zero run length, literal length, literal bytes). Zero runs shorter than 4 bytes stay in
+/// the literal, they would cost more as their own pair.
+void rle_encode(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+{
+    constexpr size_t MIN_RUN = 4;
+    out.clear();
+    size_t i = 0;
+    while (i < in.size())
+    {
+        const size_t zeros_begin = i;
+        while (i < in.size() && in[i] == 0)
+            i++;
+        const size_t literal_begin = i;
+        while (i < in.size())
+        {
+            if (in[i] == 0)
+            {
+                size_t run = 1;
+                while (run < MIN_RUN && i + run < in.size() && in[i + run] == 0)
+                    run++;
+                if (run == MIN_RUN || i + run == in.size())
+                    break;
+                i += run;
+            }
+            else
+                i++;
+        }
+        put_varint(out, literal_begin - zeros_begin);
+        put_varint(out, i - literal_begin);
+        out.insert(out.end(), in.begin() + literal_begin, in.begin() + i);
+    }
+}
+
+/// XORs the bytes stored by rle_encode() into \p target, returns false if the payload does not fill it exactly
+bool rle_xor_decode(const uint8_t* p, const uint8_t* end, std::vector<uint8_t>& target)
+{
+    size_t i = 0;
+    while (p < end)
+    {
+        size_t zeros, literal;
+        if (!get_varint(p, end, zeros) || !get_varint(p, end, literal))
+            return false;
+        if (zeros > target.size() - i || literal > target.size() - i - zeros || literal > (size_t)(end - p))
+            return false;
+        i += zeros;
+        for (size_t j = 0; j < literal; j++)
+            target[i++] ^= *p++;
+    }
+    return i == target.size();
+}
+
+} // namespace
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    close();
+}
+
+bool TrajectoryWriter::open(const std::filesystem::path& path, const pmp::SurfaceMesh& mesh,
+                            TrajectoryEncoding encoding, TrajectoryCompression compression,
+                            const std::string& parameters, uint32_t keyframe_interval)
+{
+    close();
+
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_)
+    {
+        std::cerr << "Error: Can not create trajectory " << path << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+
+    header_ = TrajectoryHeader();
+    header_.encoding_ = encoding;
+    header_.compression_ = compression;
+    header_.keyframe_interval_ = std::max(keyframe_interval, 1u);
+    header_.parameters_size_ = parameters.size();
+    header_.n_faces_ = mesh.faces_size();
+    header_.connectivity_hash_ = helpers::connectivity_hash(mesh);
+    header_.geometry_hash_ = helpers::geometry_hash(mesh);
+    frames_written_ = 0;
+    bytes_written_ = sizeof(header_) + parameters.size();
+    previous_.clear();
+
+    if (fwrite(&header_, sizeof(header_), 1, file_) != 1
+        || fwrite(parameters.data(), 1, parameters.size(), file_) != parameters.size())
+    {
+        std::cerr << "Error: Could not write trajectory header to " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool TrajectoryWriter::write(uint64_t step, const float* state)
+{
+    if (!file_)
+        return false;
+
+    encode_state(header_.encoding_, state, header_.n_faces_, encoded_);
+
+    TrajectoryFrameHeader frame;
+    frame.step_ = step;
+    const std::vector<uint8_t>* payload = &encoded_;
+    if (header_.compression_ == TrajectoryCompression::None || frames_written_ % header_.keyframe_interval_ == 0)
+        frame.flags_ |= TrajectoryFrameHeader::KEYFRAME;
+
+    if (header_.compression_ == TrajectoryCompression::DeltaRLE)
+    {
+        if (frame.flags_ & TrajectoryFrameHeader::KEYFRAME)
+            rle_encode(encoded_, payload_);
+        else
+        {
+            for (size_t i = 0; i < encoded_.size(); i++)
+                previous_[i] ^= encoded_[i];
+            rle_encode(previous_, payload_);
+        }
+        payload = &payload_;
+        std::swap(previous_, encoded_);
+    }
+    frame.payload_size_ = payload->size();
+
+    if (fwrite(&frame, sizeof(frame), 1, file_) != 1
+        || fwrite(payload->data(), 1, payload->size(), file_) != payload->size())
+    {
+        std::cerr << "Error: Could not write trajectory frame of step " << step << std::endl;
+        close();
+        return false;
+    }
+    frames_written_++;
+    bytes_written_ += sizeof(frame) + payload->size();
+    return true;
+}
+
+void TrajectoryWriter::close()
+{
+    if (file_)
+    {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+    close();
+}
+
+bool TrajectoryReader::open(const std::filesystem::path& path)
+{
+    close();
+
+    if (!file_.open(path))
+    {
+        std::cerr << "Error: Can not open trajectory " << path << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    const uint8_t* data = file_.data();
+    const size_t size = file_.size();
+    if (size < sizeof(TrajectoryHeader))
+    {
+        std::cerr << "Error: " << path << " is no trajectory (too short)" << std::endl;
+        close();
+        return false;
+    }
+
+    std::memcpy(&header_, data, sizeof(header_));
+    const TrajectoryHeader expected;
+    if (std::memcmp(header_.magic_, expected.magic_, sizeof(expected.magic_)) != 0
+        || header_.version_ != expected.version_ || header_.encoding_ > TrajectoryEncoding::Bits
+        || header_.compression_ > TrajectoryCompression::DeltaRLE
+        || header_.parameters_size_ > size - sizeof(header_))
+    {
+        std::cerr << "Error: " << path << " is no trajectory or of an unsupported version" << std::endl;
+        close();
+        return false;
+    }
+    parameters_.assign((const char*)data + sizeof(header_), header_.parameters_size_);
+
+    // index the frames, a frame cut off at the end of the file was not written completely
+    size_t offset = sizeof(header_) + header_.parameters_size_;
+    while (size - offset >= sizeof(TrajectoryFrameHeader))
+    {
+        TrajectoryFrameHeader frame;
+        std::memcpy(&frame, data + offset, sizeof(frame));
+        offset += sizeof(frame);
+        if (frame.magic_ != TrajectoryFrameHeader::MAGIC || frame.payload_size_ > size - offset)
+            break;
+        frames_.push_back({frame.step_, offset, (size_t)frame.payload_size_,
+                           (frame.flags_ & TrajectoryFrameHeader::KEYFRAME) != 0});
+        offset += frame.payload_size_;
+    }
+
+    // delta frames in front of the first keyframe can not be decoded
+    if (!frames_.empty() && !frames_.front().keyframe_)
+    {
+        std::cerr << "Error: " << path << " does not start with a keyframe" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TrajectoryReader::close()
+{
+    file_.close();
+    parameters_.clear();
+    frames_.clear();
+    decoded_.clear();
+    decoded_frame_ = SIZE_MAX;
+}
+
+bool TrajectoryReader::matches(const pmp::SurfaceMesh& mesh) const
+{
+    return header_.n_faces_ == mesh.faces_size() && header_.connectivity_hash_ == helpers::connectivity_hash(mesh);
+}
+
+bool TrajectoryReader::read(size_t i, std::vector<float>& state)
+{
+    if (i >= frames_.size())
+        return false;
+
+    if (decoded_frame_ != i)
+    {
+        size_t keyframe = i;
+        while (!frames_[keyframe].keyframe_)
+            keyframe--;
+
+        // continue from the last decoded frame when playing forward
+        size_t first = keyframe;
+        if (decoded_frame_ != SIZE_MAX && decoded_frame_ >= keyframe && decoded_frame_ < i)
+            first = decoded_frame_ + 1;
+
+        for (size_t j = first; j <= i; j++)
+        {
+            if (!decode(j))
+            {
+                std::cerr << "Error: Trajectory frame " << j << " is corrupt" << std::endl;
+                decoded_frame_ = SIZE_MAX;
+                return false;
+            }
+            decoded_frame_ = j;
+        }
+    }
+
+    decode_state(header_.encoding_, decoded_, header_.n_faces_, state);
+    return true;
+}
+
+bool TrajectoryReader::decode(size_t i)
+{
+    const Frame& frame = frames_[i];
+    const uint8_t* payload = file_.data() + frame.offset_;
+    const size_t size = encoded_size(header_.encoding_, header_.n_faces_);
+
+    if (header_.compression_ == TrajectoryCompression::None)
+    {
+        if (frame.size_ != size)
+            return false;
+        decoded_.assign(payload, payload + size);
+        return true;
+    }
+
+    // keyframes are XORed onto zeros, delta frames onto the previous frame
+    if (frame.keyframe_)
+        decoded_.assign(size, 0);
+    return rle_xor_decode(payload, payload + frame.size_, decoded_);
+}
+
+} // namespace meshlife
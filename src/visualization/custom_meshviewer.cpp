@@ -65,7 +65,7 @@ void CustomMeshViewer::load_mesh(const char* filename)
     // renderer_.set_crease_angle(crease_angle_);
 }
 
-void CustomMeshViewer::update_mesh()
+void CustomMeshViewer::update_mesh(bool geometry_changed)
 {
     // update scene center and radius, but don't update camera view
     pmp::BoundingBox bb = bounds(mesh_);
@@ -75,6 +75,8 @@ void CustomMeshViewer::update_mesh()
     radius_ = 0.5f * bb.size();
 
     // re-compute face and vertex normals
+    if (geometry_changed)
+        renderer_.invalidate_geometry();
     renderer_.update_opengl_buffers();
 }
 
@@ -1,17 +1,48 @@
 #include "meshlife/visualization/custom_renderer.h"
 #include "gl_helper.h"
 #include "meshlife/paths.h"
-#include "pmp/algorithms/normals.h"
+#include "meshlife/visualization/face_id_shader.h"
 #include "pmp/mat_vec.h"
 #include "pmp/surface_mesh.h"
 
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+#include <filesystem>
+#include <fstream>
+
 namespace meshlife
 
 {
 
+namespace
+{
+
+/// Reads the shader \p path and replaces every line #include "<file>" with the contents of <file> in the same
+/// directory, so shaders can share code. Throws pmp::GLException if a file can not be read.
+std::string read_shader_source(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw pmp::GLException("Can not open shader " + path.string());
+
+    const std::string directive = "#include \"";
+    std::string source;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const size_t end = line.find('"', directive.size());
+        if (line.rfind(directive, 0) == 0 && end != std::string::npos)
+            source += read_shader_source(path.parent_path() / line.substr(directive.size(), end - directive.size()));
+        else
+            source += line;
+        source += '\n';
+    }
+    return source;
+}
+
+} // namespace
+
 CustomRenderer::CustomRenderer(const pmp::SurfaceMesh& mesh, GLFWwindow* window) : mesh_(mesh), window_(window)
 {
     // material parameters
@@ -37,10 +68,20 @@ CustomRenderer::~CustomRenderer()
     GL_CHECK(glDeleteBuffers(1, &MESH_tex_coord_buffer_));
     GL_CHECK(glDeleteBuffers(1, &MESH_edge_buffer_));
     GL_CHECK(glDeleteBuffers(1, &MESH_feature_buffer_));
+    GL_CHECK(glDeleteBuffers(1, &MESH_face_id_buffer_));
+    GL_CHECK(glDeleteBuffers(1, &MESH_index_buffer_));
+    GL_CHECK(glDeleteBuffers(1, &MESH_triangle_face_buffer_));
+    GL_CHECK(glDeleteTextures(1, &MESH_triangle_face_texture_));
+    GL_CHECK(glDeleteBuffers(1, &MESH_state_buffer_));
+    GL_CHECK(glDeleteTextures(1, &MESH_state_texture_));
     GL_CHECK(glDeleteVertexArrays(1, &MESH_VAO_));
 
     GL_CHECK(glDeleteFramebuffers(1, &g_framebuffer_));
     GL_CHECK(glDeleteBuffers(1, &g_depthbuffer_));
+
+    GL_CHECK(glDeleteFramebuffers(1, &pick_framebuffer_));
+    GL_CHECK(glDeleteRenderbuffers(1, &pick_face_buffer_));
+    GL_CHECK(glDeleteRenderbuffers(1, &pick_depth_buffer_));
 }
 
 void CustomRenderer::draw(const pmp::mat4& projection_matrix,
@@ -61,6 +102,19 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
         update_opengl_buffers();
     }
 
+    // window size and shader time change every frame, independent of the mesh buffers
+    glfwGetWindowSize(window_, &wsize_, &hsize_);
+
+    // the picking pass shows what is drawn now, faces can only be picked where triangles are visible
+    pick_mvp_matrix_ = mvp_matrix;
+    pick_pass_valid_ = false;
+    pick_faces_drawn_ = draw_mode == "Hidden Line" || draw_mode == "Smooth Shading" || draw_mode == "No Shading"
+                        || draw_mode == "Skybox with model" || draw_mode == "Reflective Sphere";
+    if (!itime_paused_)
+    {
+        itime_ = glfwGetTime();
+    }
+
     // load shader
     if (!phong_shader_.is_valid())
     {
@@ -135,12 +189,16 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
     phong_shader_.set_uniform("use_srgb", false);
     phong_shader_.set_uniform("show_texture_layout", false);
     phong_shader_.set_uniform("use_vertex_color", has_vertex_colors_ && use_colors_);
+    bind_face_state(phong_shader_);
 
     if (draw_mode == "Points")
     {
 #ifndef __EMSCRIPTEN__
         glEnable(GL_PROGRAM_POINT_SIZE);
 #endif
+        // points have no triangle to look up their face from
+        if (buffers_.indexed())
+            phong_shader_.set_uniform("use_face_state", false);
         GL_CHECK(glDrawArrays(GL_POINTS, 0, n_vertices_));
     }
 
@@ -150,7 +208,7 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
         {
             // draw faces
             GL_CHECK(glDepthRange(0.01, 1.0));
-            GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, n_vertices_));
+            draw_triangles();
             GL_CHECK(glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE));
 
             // overlay edges
@@ -160,6 +218,7 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
             phong_shader_.set_uniform("back_color", vec3(0.1, 0.1, 0.1));
             phong_shader_.set_uniform("use_lighting", false);
             phong_shader_.set_uniform("use_vertex_color", false);
+            phong_shader_.set_uniform("use_face_state", false);
             GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, MESH_edge_buffer_));
             GL_CHECK(glDrawElements(GL_LINES, n_edges_, GL_UNSIGNED_INT, nullptr));
             GL_CHECK(glDepthFunc(GL_LESS));
@@ -169,7 +228,7 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
     {
         if (mesh_.n_faces())
         {
-            GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, n_vertices_));
+            draw_triangles();
         }
     }
     else if (draw_mode == "No Shading")
@@ -178,7 +237,7 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
         phong_shader_.set_uniform("use_lighting", false);
         if (mesh_.n_faces())
         {
-            GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, n_vertices_));
+            draw_triangles();
         }
     }
 
@@ -188,6 +247,7 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
         phong_shader_.set_uniform("front_color", vec3(0, 1, 0));
         phong_shader_.set_uniform("back_color", vec3(0, 1, 0));
         phong_shader_.set_uniform("use_vertex_color", false);
+        phong_shader_.set_uniform("use_face_state", false);
         phong_shader_.set_uniform("use_lighting", false);
         GL_CHECK(glDepthRange(0.0, 1.0));
         GL_CHECK(glDepthFunc(GL_LEQUAL));
@@ -244,6 +304,7 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
         // reflective_sphere_shader_.set_uniform("use_texture", false);
         reflective_sphere_shader_.set_uniform("use_srgb", false);
         reflective_sphere_shader_.set_uniform("use_vertex_color", has_vertex_colors_ && use_colors_);
+        bind_face_state(reflective_sphere_shader_);
         reflective_sphere_shader_.set_uniform("show_texture_layout", false);
 
         GL_CHECK(glBindVertexArray(MESH_VAO_));
@@ -256,7 +317,7 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
         else
             GL_CHECK(glBindTexture(GL_TEXTURE_CUBE_MAP, g_cubeTexture_));
 
-        GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, n_vertices_));
+        draw_triangles();
 
         reflective_sphere_shader_.disable();
         GL_CHECK(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
@@ -359,6 +420,7 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
         // reflective_sphere_shader_.set_uniform("use_texture", false);
         reflective_sphere_shader_.set_uniform("use_srgb", false);
         reflective_sphere_shader_.set_uniform("use_vertex_color", has_vertex_colors_ && use_colors_);
+        bind_face_state(reflective_sphere_shader_);
 
         reflective_sphere_shader_.set_uniform("show_texture_layout", false);
 
@@ -372,7 +434,7 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
         else
             GL_CHECK(glBindTexture(GL_TEXTURE_CUBE_MAP, g_cubeTexture_));
 
-        GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, n_vertices_));
+        draw_triangles();
 
         reflective_sphere_shader_.disable();
         GL_CHECK(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
@@ -423,14 +485,6 @@ void CustomRenderer::draw(const pmp::mat4& projection_matrix,
 
 void CustomRenderer::update_opengl_buffers()
 {
-    glfwGetWindowSize(window_, &wsize_, &hsize_);
-
-    // get time in seconds
-    if (!itime_paused_)
-    {
-        itime_ = glfwGetTime();
-    }
-
     if (!g_framebuffer_)
     {
         GL_CHECK(glGenFramebuffers(1, &g_framebuffer_));
@@ -447,6 +501,12 @@ void CustomRenderer::update_opengl_buffers()
         GL_CHECK(glGenBuffers(1, &MESH_tex_coord_buffer_));
         GL_CHECK(glGenBuffers(1, &MESH_edge_buffer_));
         GL_CHECK(glGenBuffers(1, &MESH_feature_buffer_));
+        GL_CHECK(glGenBuffers(1, &MESH_face_id_buffer_));
+        GL_CHECK(glGenBuffers(1, &MESH_index_buffer_));
+        GL_CHECK(glGenBuffers(1, &MESH_triangle_face_buffer_));
+        GL_CHECK(glGenTextures(1, &MESH_triangle_face_texture_));
+        GL_CHECK(glGenBuffers(1, &MESH_state_buffer_));
+        GL_CHECK(glGenTextures(1, &MESH_state_texture_));
     }
 
     if (!skybox_VAO_)
@@ -467,193 +527,23 @@ void CustomRenderer::update_opengl_buffers()
 
     // activate VAO
     GL_CHECK(glBindVertexArray(MESH_VAO_));
+    pick_pass_valid_ = false;
 
-    // get properties
-    auto vpos = mesh_.get_vertex_property<pmp::Point>("v:point");
-    auto vcolor = mesh_.get_vertex_property<pmp::Color>("v:color");
-    auto vtex = mesh_.get_vertex_property<pmp::TexCoord>("v:tex");
-    auto htex = mesh_.get_halfedge_property<pmp::TexCoord>("h:tex");
-    auto fcolor = mesh_.get_face_property<pmp::Color>("f:color");
-
-    // index array for remapping vertex indices during duplication
-    std::vector<size_t> vertex_indices(mesh_.n_vertices());
-
-    // produce arrays of points, normals, and texcoords
-    // (duplicate vertices to allow for flat shading)
-    std::vector<pmp::vec3> position_array;
-    std::vector<pmp::vec3> color_array;
-    std::vector<pmp::vec3> normal_array;
-    std::vector<pmp::vec2> tex_array;
-    std::vector<pmp::ivec3> triangles;
-
-    // we have a mesh: fill arrays by looping over faces
-    if (mesh_.n_faces())
-    {
-        // reserve memory
-        position_array.reserve(3 * mesh_.n_faces());
-        normal_array.reserve(3 * mesh_.n_faces());
-        if (htex || vtex)
-            tex_array.reserve(3 * mesh_.n_faces());
-
-        if ((vcolor || fcolor) && use_colors_)
-            color_array.reserve(3 * mesh_.n_faces());
-
-        // precompute normals for easy cases
-        std::vector<pmp::Normal> face_normals;
-        std::vector<pmp::Normal> vertex_normals;
-        face_normals.reserve(mesh_.n_faces());
-        vertex_normals.reserve(mesh_.n_vertices());
-        if (crease_angle_ < 1)
-        {
-            for (auto f : mesh_.faces())
-                face_normals.emplace_back(pmp::face_normal(mesh_, f));
-        }
-        else if (crease_angle_ > 170)
-        {
-            for (auto v : mesh_.vertices())
-                vertex_normals.emplace_back(vertex_normal(mesh_, v));
-        }
-
-        // data per face (for all corners)
-        std::vector<pmp::Halfedge> corner_halfedges;
-        std::vector<pmp::Vertex> corner_vertices;
-        std::vector<pmp::vec3> corner_positions;
-        std::vector<pmp::vec3> corner_colors;
-        std::vector<pmp::vec3> corner_normals;
-        std::vector<pmp::vec2> corner_texcoords;
-
-        // convert from degrees to radians
-        const pmp::Scalar crease_angle_radians = crease_angle_ / 180.0 * M_PI;
-
-        size_t vidx(0);
-
-        // loop over all faces
-        for (auto f : mesh_.faces())
-        {
-            // collect corner positions and normals
-            corner_halfedges.clear();
-            corner_vertices.clear();
-            corner_positions.clear();
-            corner_colors.clear();
-            corner_normals.clear();
-            corner_texcoords.clear();
-            pmp::Vertex v;
-            pmp::Normal n;
-
-            for (auto h : mesh_.halfedges(f))
-            {
-                v = mesh_.to_vertex(h);
-                corner_halfedges.push_back(h);
-                corner_vertices.push_back(v);
-                corner_positions.push_back((pmp::vec3)vpos[v]);
-
-                if (crease_angle_ < 1)
-                {
-                    n = face_normals[f.idx()];
-                }
-                else if (crease_angle_ > 170)
-                {
-                    n = vertex_normals[v.idx()];
-                }
-                else
-                {
-                    n = corner_normal(mesh_, h, crease_angle_radians);
-                }
-                corner_normals.push_back((pmp::vec3)n);
-
-                if (htex)
-                {
-                    corner_texcoords.push_back((pmp::vec2)htex[h]);
-                }
-                else if (vtex)
-                {
-                    corner_texcoords.push_back((pmp::vec2)vtex[v]);
-                }
-
-                if (vcolor && use_colors_)
-                {
-                    corner_colors.push_back((pmp::vec3)vcolor[v]);
-                }
-                else if (fcolor && use_colors_)
-                {
-                    corner_colors.push_back((pmp::vec3)fcolor[f]);
-                }
-            }
-            assert(corner_vertices.size() >= 3);
-
-            // tessellate face into triangles
-            tesselate(corner_positions, triangles);
-            for (auto& t : triangles)
-            {
-                int i0 = t[0];
-                int i1 = t[1];
-                int i2 = t[2];
-
-                position_array.push_back(corner_positions[i0]);
-                position_array.push_back(corner_positions[i1]);
-                position_array.push_back(corner_positions[i2]);
-
-                normal_array.push_back(corner_normals[i0]);
-                normal_array.push_back(corner_normals[i1]);
-                normal_array.push_back(corner_normals[i2]);
-
-                if (htex || vtex)
-                {
-                    tex_array.push_back(corner_texcoords[i0]);
-                    tex_array.push_back(corner_texcoords[i1]);
-                    tex_array.push_back(corner_texcoords[i2]);
-                }
-
-                if ((vcolor || fcolor) && use_colors_)
-                {
-                    color_array.push_back(corner_colors[i0]);
-                    color_array.push_back(corner_colors[i1]);
-                    color_array.push_back(corner_colors[i2]);
-                }
-
-                vertex_indices[corner_vertices[i0].idx()] = vidx++;
-                vertex_indices[corner_vertices[i1].idx()] = vidx++;
-                vertex_indices[corner_vertices[i2].idx()] = vidx++;
-            }
-        }
-    }
-
-    // we have a point cloud
-    else if (mesh_.n_vertices())
-    {
-        auto position = mesh_.get_vertex_property<pmp::Point>("v:point");
-        if (position)
-        {
-            position_array.reserve(mesh_.n_vertices());
-            for (auto v : mesh_.vertices())
-                position_array.push_back((pmp::vec3)position[v]);
-        }
-
-        auto normals = mesh_.get_vertex_property<pmp::Point>("v:normal");
-        if (normals)
-        {
-            normal_array.reserve(mesh_.n_vertices());
-            for (auto v : mesh_.vertices())
-                normal_array.push_back((pmp::vec3)normals[v]);
-        }
-
-        if (vcolor && use_colors_)
-        {
-            color_array.reserve(mesh_.n_vertices());
-            for (auto v : mesh_.vertices())
-                color_array.push_back((pmp::vec3)vcolor[v]);
-        }
-    }
+    // build the vertex arrays on the CPU
+    buffers_.build(mesh_, crease_angle_, use_colors_);
+    const std::vector<pmp::vec3>& positions = buffers_.positions();
+    const std::vector<pmp::vec3>& normals = buffers_.normals();
+    const std::vector<pmp::vec2>& tex_coords = buffers_.tex_coords();
+    const std::vector<pmp::vec3>& colors = buffers_.colors();
 
     // upload vertices
-    if (!position_array.empty())
+    if (!positions.empty())
     {
         GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, MESH_vertex_buffer_));
-        GL_CHECK(glBufferData(
-            GL_ARRAY_BUFFER, position_array.size() * 3 * sizeof(float), position_array.data(), GL_STATIC_DRAW));
+        GL_CHECK(glBufferData(GL_ARRAY_BUFFER, positions.size() * 3 * sizeof(float), positions.data(), GL_STATIC_DRAW));
         GL_CHECK(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr));
         GL_CHECK(glEnableVertexAttribArray(0));
-        n_vertices_ = position_array.size();
+        n_vertices_ = positions.size();
     }
     else
     {
@@ -662,11 +552,10 @@ void CustomRenderer::update_opengl_buffers()
     }
 
     // upload normals
-    if (!normal_array.empty())
+    if (!normals.empty())
     {
         GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, MESH_normal_buffer_));
-        GL_CHECK(glBufferData(
-            GL_ARRAY_BUFFER, normal_array.size() * 3 * sizeof(float), normal_array.data(), GL_STATIC_DRAW));
+        GL_CHECK(glBufferData(GL_ARRAY_BUFFER, normals.size() * 3 * sizeof(float), normals.data(), GL_STATIC_DRAW));
         GL_CHECK(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr));
         GL_CHECK(glEnableVertexAttribArray(1));
     }
@@ -676,10 +565,11 @@ void CustomRenderer::update_opengl_buffers()
     }
 
     // upload texture coordinates
-    if (!tex_array.empty())
+    if (!tex_coords.empty())
     {
         GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, MESH_tex_coord_buffer_));
-        GL_CHECK(glBufferData(GL_ARRAY_BUFFER, tex_array.size() * 2 * sizeof(float), tex_array.data(), GL_STATIC_DRAW));
+        GL_CHECK(
+            glBufferData(GL_ARRAY_BUFFER, tex_coords.size() * 2 * sizeof(float), tex_coords.data(), GL_STATIC_DRAW));
         GL_CHECK(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr));
         GL_CHECK(glEnableVertexAttribArray(2));
         has_texcoords_ = true;
@@ -691,11 +581,10 @@ void CustomRenderer::update_opengl_buffers()
     }
 
     // upload colors of vertices
-    if (!color_array.empty())
+    if (!colors.empty())
     {
         GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, MESH_color_buffer_));
-        GL_CHECK(
-            glBufferData(GL_ARRAY_BUFFER, color_array.size() * 3 * sizeof(float), color_array.data(), GL_STATIC_DRAW));
+        GL_CHECK(glBufferData(GL_ARRAY_BUFFER, colors.size() * 3 * sizeof(float), colors.data(), GL_STATIC_DRAW));
         GL_CHECK(glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, nullptr));
         GL_CHECK(glEnableVertexAttribArray(3));
         has_vertex_colors_ = true;
@@ -706,57 +595,228 @@ void CustomRenderer::update_opengl_buffers()
         has_vertex_colors_ = false;
     }
 
-    // edge indices
-    if (mesh_.n_edges())
+    // upload face indices, used to look up the face state
+    const std::vector<uint32_t>& face_ids = buffers_.face_ids();
+    if (!face_ids.empty())
     {
-        std::vector<unsigned int> edge_indices;
-        edge_indices.reserve(mesh_.n_edges());
+        GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, MESH_face_id_buffer_));
+        GL_CHECK(glBufferData(GL_ARRAY_BUFFER, face_ids.size() * sizeof(uint32_t), face_ids.data(), GL_STATIC_DRAW));
+        GL_CHECK(glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, 0, nullptr));
+        GL_CHECK(glEnableVertexAttribArray(4));
+        has_face_ids_ = true;
+    }
+    else
+    {
+        GL_CHECK(glDisableVertexAttribArray(4));
+        has_face_ids_ = false;
+    }
 
-        for (auto e : mesh_.edges())
-        {
-            auto v0 = mesh_.vertex(e, 0).idx();
-            auto v1 = mesh_.vertex(e, 1).idx();
-            edge_indices.push_back(vertex_indices[v0]);
-            edge_indices.push_back(vertex_indices[v1]);
-        }
+    // upload triangles of the indexed layout, their faces are looked up by gl_PrimitiveID
+    if (buffers_.indexed())
+    {
+        const std::vector<uint32_t>& indices = buffers_.triangle_indices();
+        const std::vector<uint32_t>& triangle_faces = buffers_.triangle_faces();
+        GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, MESH_index_buffer_));
+        GL_CHECK(
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW));
+        n_indices_ = indices.size();
 
+        GL_CHECK(glBindBuffer(GL_TEXTURE_BUFFER, MESH_triangle_face_buffer_));
+        GL_CHECK(glBufferData(
+            GL_TEXTURE_BUFFER, triangle_faces.size() * sizeof(uint32_t), triangle_faces.data(), GL_STATIC_DRAW));
+        GL_CHECK(glBindTexture(GL_TEXTURE_BUFFER, MESH_triangle_face_texture_));
+        GL_CHECK(glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, MESH_triangle_face_buffer_));
+        GL_CHECK(glBindTexture(GL_TEXTURE_BUFFER, 0));
+        GL_CHECK(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+    }
+    else
+        n_indices_ = 0;
+
+    // edge indices
+    const std::vector<unsigned int>& edge_indices = buffers_.edge_indices();
+    if (!edge_indices.empty())
+    {
         GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, MESH_edge_buffer_));
         GL_CHECK(glBufferData(
             GL_ELEMENT_ARRAY_BUFFER, edge_indices.size() * sizeof(unsigned int), edge_indices.data(), GL_STATIC_DRAW));
-        n_edges_ = edge_indices.size();
     }
-    else
-        n_edges_ = 0;
+    n_edges_ = edge_indices.size();
 
     // feature edges
-    auto efeature = mesh_.get_edge_property<bool>("e:feature");
-    if (efeature)
+    const std::vector<unsigned int>& features = buffers_.feature_indices();
+    if (!features.empty())
     {
-        std::vector<unsigned int> features;
-
-        for (auto e : mesh_.edges())
-        {
-            if (efeature[e])
-            {
-                auto v0 = mesh_.vertex(e, 0).idx();
-                auto v1 = mesh_.vertex(e, 1).idx();
-                features.push_back(vertex_indices[v0]);
-                features.push_back(vertex_indices[v1]);
-            }
-        }
-
         GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, MESH_feature_buffer_));
         GL_CHECK(glBufferData(
             GL_ELEMENT_ARRAY_BUFFER, features.size() * sizeof(unsigned int), features.data(), GL_STATIC_DRAW));
-        n_features_ = features.size();
     }
-    else
-        n_features_ = 0;
+    n_features_ = features.size();
+
 
     // unbind object
     GL_CHECK(glBindVertexArray(0));
 }
 
+void CustomRenderer::update_state_buffer(const std::vector<float>& state)
+{
+    if (!MESH_VAO_)
+        update_opengl_buffers();
+
+    n_state_values_ = state.size();
+    if (state.empty())
+        return;
+
+    // 4 bytes per face, instead of a color for every triangle corner
+    GL_CHECK(glBindBuffer(GL_TEXTURE_BUFFER, MESH_state_buffer_));
+    if (state.size() == state_buffer_size_)
+    {
+        GL_CHECK(glBufferSubData(GL_TEXTURE_BUFFER, 0, state.size() * sizeof(float), state.data()));
+    }
+    else
+    {
+        GL_CHECK(glBufferData(GL_TEXTURE_BUFFER, state.size() * sizeof(float), state.data(), GL_DYNAMIC_DRAW));
+        GL_CHECK(glBindTexture(GL_TEXTURE_BUFFER, MESH_state_texture_));
+        GL_CHECK(glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, MESH_state_buffer_));
+        GL_CHECK(glBindTexture(GL_TEXTURE_BUFFER, 0));
+        state_buffer_size_ = state.size();
+    }
+    GL_CHECK(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+}
+
+void CustomRenderer::draw_triangles()
+{
+    if (buffers_.indexed())
+    {
+        // the element buffer binding is part of the VAO, edges may have replaced it
+        GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, MESH_index_buffer_));
+        GL_CHECK(glDrawElements(GL_TRIANGLES, n_indices_, GL_UNSIGNED_INT, nullptr));
+    }
+    else
+    {
+        GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, n_vertices_));
+    }
+}
+
+pmp::Face CustomRenderer::pick_face(int x, int y)
+{
+    if (!MESH_VAO_ || !mesh_.n_faces() || !pick_faces_drawn_ || pick_pass_failed_)
+        return pmp::Face();
+
+    if (!pick_pass_valid_)
+        draw_face_id_pass();
+    if (!pick_pass_valid_ || x < 0 || y < 0 || x >= pick_width_ || y >= pick_height_)
+        return pmp::Face();
+
+    // in OpenGL y=0 is at the bottom. The driver has to finish the pass, but only 4 bytes come back
+    GLuint id = 0;
+    GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, pick_framebuffer_));
+    GL_CHECK(glReadBuffer(GL_COLOR_ATTACHMENT0));
+    GL_CHECK(glReadPixels(x, pick_height_ - 1 - y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &id));
+    GL_CHECK(glBindFramebuffer(GL_READ_FRAMEBUFFER, 0));
+
+    if (id == 0 || id > mesh_.faces_size())
+        return pmp::Face();
+    const pmp::Face face(id - 1);
+    return mesh_.is_deleted(face) ? pmp::Face() : face;
+}
+
+void CustomRenderer::draw_face_id_pass()
+{
+    if (!face_id_shader_.is_valid())
+    {
+        try
+        {
+            face_id_shader_.source(face_id_vshader, face_id_fshader);
+        }
+        catch (pmp::GLException& e)
+        {
+            std::cerr << "Error: loading face id shader failed" << std::endl;
+            std::cerr << e.what() << std::endl;
+            pick_pass_failed_ = true;
+            return;
+        }
+    }
+
+    // same size as the default framebuffer, which the cursor position refers to
+    int width, height;
+    glfwGetFramebufferSize(window_, &width, &height);
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (!pick_framebuffer_)
+    {
+        GL_CHECK(glGenFramebuffers(1, &pick_framebuffer_));
+        GL_CHECK(glGenRenderbuffers(1, &pick_face_buffer_));
+        GL_CHECK(glGenRenderbuffers(1, &pick_depth_buffer_));
+    }
+
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, pick_framebuffer_));
+    if (width != pick_width_ || height != pick_height_)
+    {
+        GL_CHECK(glBindRenderbuffer(GL_RENDERBUFFER, pick_face_buffer_));
+        GL_CHECK(glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height));
+        GL_CHECK(glBindRenderbuffer(GL_RENDERBUFFER, pick_depth_buffer_));
+        GL_CHECK(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
+        GL_CHECK(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+        GL_CHECK(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, pick_face_buffer_));
+        GL_CHECK(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, pick_depth_buffer_));
+        pick_width_ = width;
+        pick_height_ = height;
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Error: Picking framebuffer invalid" << std::endl;
+        GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+        pick_pass_failed_ = true;
+        return;
+    }
+
+    // same viewport and depth test as the visible pass, so every pixel shows the face drawn there
+    const GLuint background = 0;
+    const GLfloat depth = 1.0f;
+    GL_CHECK(glClearBufferuiv(GL_COLOR, 0, &background));
+    GL_CHECK(glClearBufferfv(GL_DEPTH, 0, &depth));
+    GL_CHECK(glViewport(0, 0, wsize_, hsize_));
+    GL_CHECK(glDepthRange(0.0, 1.0));
+    GL_CHECK(glDepthFunc(GL_LESS));
+
+    face_id_shader_.use();
+    face_id_shader_.set_uniform("modelview_projection_matrix", pick_mvp_matrix_);
+    face_id_shader_.set_uniform("triangle_faces", 2);
+    face_id_shader_.set_uniform("use_triangle_faces", buffers_.indexed());
+    GL_CHECK(glActiveTexture(GL_TEXTURE2));
+    GL_CHECK(glBindTexture(GL_TEXTURE_BUFFER, buffers_.indexed() ? MESH_triangle_face_texture_ : 0));
+    GL_CHECK(glActiveTexture(GL_TEXTURE0));
+
+    GL_CHECK(glBindVertexArray(MESH_VAO_));
+    draw_triangles();
+    GL_CHECK(glBindVertexArray(0));
+    face_id_shader_.disable();
+
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    pick_pass_valid_ = true;
+}
+
+void CustomRenderer::bind_face_state(pmp::Shader& shader)
+{
+    const bool use_face_state = use_colors_ && (has_face_ids_ || buffers_.indexed()) && n_state_values_ > 0
+                                && n_state_values_ == mesh_.faces_size();
+
+    // own texture units, samplers of different types must not share one
+    GL_CHECK(glActiveTexture(GL_TEXTURE1));
+    GL_CHECK(glBindTexture(GL_TEXTURE_BUFFER, use_face_state ? MESH_state_texture_ : 0));
+    GL_CHECK(glActiveTexture(GL_TEXTURE2));
+    GL_CHECK(glBindTexture(GL_TEXTURE_BUFFER, buffers_.indexed() ? MESH_triangle_face_texture_ : 0));
+    GL_CHECK(glActiveTexture(GL_TEXTURE0));
+
+    shader.set_uniform("face_state", 1);
+    shader.set_uniform("triangle_faces", 2);
+    shader.set_uniform("use_triangle_faces", buffers_.indexed());
+    shader.set_uniform("use_face_state", use_face_state);
+    shader.set_uniform("colormap", (int)colormap_);
+}
+
 void CustomRenderer::set_simple_shader_files(std::string simple_shader_path_vertex,
                                              std::string custom_shader_path_fragment)
 {
@@ -899,8 +959,9 @@ void CustomRenderer::load_reflective_sphere_shader()
 {
     try
     {
-        reflective_sphere_shader_.load(reflective_sphere_vertex_shader_file_path_.c_str(),
-                                       reflective_sphere_fragment_shader_file_path_.c_str());
+        // the fragment shader includes colormap.glsl
+        reflective_sphere_shader_.source(read_shader_source(reflective_sphere_vertex_shader_file_path_).c_str(),
+                                         read_shader_source(reflective_sphere_fragment_shader_file_path_).c_str());
     }
     catch (pmp::GLException& e)
     {
@@ -913,7 +974,9 @@ void CustomRenderer::load_phong_shader()
 {
     try
     {
-        phong_shader_.load(phong_vertex_shader_file_path_.c_str(), phong_fragment_shader_file_path_.c_str());
+        // the fragment shader includes colormap.glsl
+        phong_shader_.source(read_shader_source(phong_vertex_shader_file_path_).c_str(),
+                             read_shader_source(phong_fragment_shader_file_path_).c_str());
     }
     catch (pmp::GLException& e)
     {
@@ -1125,96 +1188,4 @@ unsigned int CustomRenderer::load_cubemap(std::vector<std::string> faces)
     return texture_id;
 }
 
-// triangulate a polygon such that the sum of squared triangle areas is minimized.
-// this prevents overlapping/folding triangles for non-convex polygons.
-void CustomRenderer::tesselate(const std::vector<pmp::vec3>& points, std::vector<pmp::ivec3>& triangles)
-{
-    const int n = points.size();
-
-    triangles.clear();
-    triangles.reserve(n - 2);
-
-    // triangle? nothing to do
-    if (n == 3)
-    {
-        triangles.emplace_back(0, 1, 2);
-        return;
-    }
-
-    // quad? simply compare to two options
-    if (n == 4)
-    {
-        if (area(points[0], points[1], points[2]) + area(points[0], points[2], points[3])
-            < area(points[0], points[1], points[3]) + area(points[1], points[2], points[3]))
-        {
-            triangles.emplace_back(0, 1, 2);
-            triangles.emplace_back(0, 2, 3);
-        }
-        else
-        {
-            triangles.emplace_back(0, 1, 3);
-            triangles.emplace_back(1, 2, 3);
-        }
-        return;
-    }
-
-    // n-gon with n>4? compute triangulation by dynamic programming
-    init_triangulation(n);
-    int i, j, m, k, imin;
-    pmp::Scalar w, wmin;
-
-    // initialize 2-gons
-    for (i = 0; i < n - 1; ++i)
-    {
-        triangulation(i, i + 1) = Triangulation(0.0, -1);
-    }
-
-    // n-gons with n>2
-    for (j = 2; j < n; ++j)
-    {
-        // for all n-gons [i,i+j]
-        for (i = 0; i < n - j; ++i)
-        {
-            k = i + j;
-
-            wmin = std::numeric_limits<pmp::Scalar>::max();
-            imin = -1;
-
-            // find best split i < m < i+j
-            for (m = i + 1; m < k; ++m)
-            {
-                w = triangulation(i, m).area_ + area(points[i], points[m], points[k]) + triangulation(m, k).area_;
-
-                if (w < wmin)
-                {
-                    wmin = w;
-                    imin = m;
-                }
-            }
-
-            triangulation(i, k) = Triangulation(wmin, imin);
-        }
-    }
-
-    // build triangles from triangulation table
-    std::vector<pmp::ivec2> todo;
-    todo.reserve(n);
-    todo.emplace_back(0, n - 1);
-    while (!todo.empty())
-    {
-        pmp::ivec2 tri = todo.back();
-        todo.pop_back();
-        int start = tri[0];
-        int end = tri[1];
-        if (end - start < 2)
-            continue;
-        int split = triangulation(start, end).split_;
-
-        triangles.emplace_back(start, split, end);
-
-        todo.emplace_back(start, split);
-        todo.emplace_back(split, end);
-    }
-}
-
 } // namespace meshlife
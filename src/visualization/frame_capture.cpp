@@ -0,0 +1,109 @@
+#include "meshlife/visualization/frame_capture.h"
+#include "gl_helper.h"
+
+#include <algorithm>
+
+namespace meshlife
+{
+
+FrameCapture::~FrameCapture()
+{
+    release();
+}
+
+void FrameCapture::start(int width, int height, int ring_size)
+{
+    release();
+    width_ = width;
+    height_ = height;
+
+    const size_t size = (size_t)3 * width * height;
+    slots_.resize(std::max(ring_size, 1));
+    for (auto& slot : slots_)
+    {
+        GL_CHECK(glGenBuffers(1, &slot.buffer));
+        GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer));
+        GL_CHECK(glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ));
+    }
+    GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+}
+
+void FrameCapture::read(int frame, const Consumer& consume)
+{
+    if (slots_.empty())
+        return;
+
+    // all buffers in flight, the oldest frame has to make room
+    if (pending_ == slots_.size())
+        consume_oldest(consume);
+
+    Slot& slot = slots_[(oldest_ + pending_) % slots_.size()];
+    slot.frame = frame;
+
+    // with a pack buffer bound, glReadPixels only records the copy and returns right away
+    GL_CHECK(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer));
+    GL_CHECK(glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, nullptr));
+    GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pending_++;
+}
+
+void FrameCapture::collect(const Consumer& consume, bool wait)
+{
+    while (pending_)
+    {
+        if (!wait)
+        {
+            // only poll, frames finish in order
+            const GLenum status = glClientWaitSync(slots_[oldest_].fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+        }
+        consume_oldest(consume);
+    }
+}
+
+void FrameCapture::consume_oldest(const Consumer& consume)
+{
+    Slot& slot = slots_[oldest_];
+
+    // flush once, so the fence is guaranteed to signal while we wait
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(slot.fence, flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+        flags = 0;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    const size_t size = (size_t)3 * width_ * height_;
+    GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer));
+    auto* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels)
+    {
+        consume(slot.frame, pixels);
+        GL_CHECK(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+    }
+    else
+    {
+        std::cerr << "Error: Could not map the pixels of frame " << slot.frame << std::endl;
+    }
+    GL_CHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+    oldest_ = (oldest_ + 1) % slots_.size();
+    pending_--;
+}
+
+void FrameCapture::release()
+{
+    for (auto& slot : slots_)
+    {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        GL_CHECK(glDeleteBuffers(1, &slot.buffer));
+    }
+    slots_.clear();
+    oldest_ = 0;
+    pending_ = 0;
+}
+
+} // namespace meshlife
@@ -0,0 +1,226 @@
+#include "meshlife/visualization/frame_encoder.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stb_image_write.h>
+
+namespace meshlife
+{
+
+FrameEncoder::~FrameEncoder()
+{
+    finish();
+}
+
+bool FrameEncoder::start(int width, int height, int slot_count, const std::string& format, int n_workers)
+{
+    finish();
+    if (!allocate(width, height, slot_count))
+        return false;
+    format_ = format;
+
+    // global setting of stb, set before the workers run
+    stbi_flip_vertically_on_write(true);
+
+    // leave one core to the render loop
+    if (n_workers <= 0)
+        n_workers = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+    start_workers(n_workers);
+    return true;
+}
+
+bool FrameEncoder::start_video(int width, int height, int slot_count, int framerate, const std::filesystem::path& file)
+{
+    finish();
+    if (std::system("ffmpeg -version > /dev/null 2>&1") != 0)
+    {
+        std::cerr << "Error: ffmpeg not found in path" << std::endl;
+        return false;
+    }
+    if (!allocate(width, height, slot_count))
+        return false;
+
+    // the frames are bottom row first, like OpenGL reads them
+    std::stringstream command;
+    command << "ffmpeg -hide_banner -loglevel warning -y -f rawvideo -pix_fmt rgb24 -s " << width << "x" << height
+            << " -framerate " << framerate << " -i - -vf vflip -c:v libx264 -pix_fmt yuv420p "
+            << std::filesystem::absolute(file);
+    std::cout << "Running: '" << command.str() << "'" << std::endl;
+
+    // a crashed ffmpeg must only fail the writes instead of killing the viewer with SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+    pipe_ = popen(command.str().c_str(), "w");
+    if (!pipe_)
+    {
+        std::cerr << "Error: Could not start ffmpeg" << std::endl;
+        slots_.clear();
+        return false;
+    }
+
+    // frames have to arrive in order, ffmpeg encodes on its own threads
+    start_workers(1);
+    return true;
+}
+
+bool FrameEncoder::allocate(int width, int height, int slot_count)
+{
+    width_ = width;
+    height_ = height;
+    try
+    {
+        slots_.resize(std::max(slot_count, 1));
+        for (auto& slot : slots_)
+            slot.pixels.resize((size_t)3 * width * height);
+    }
+    catch (std::bad_alloc& e)
+    {
+        std::cerr << "Error: Not enough memory for buffer\n" << e.what() << std::endl;
+        slots_.clear();
+        return false;
+    }
+    catch (std::length_error& e)
+    {
+        std::cerr << "Error: Not enough memory for buffer\n" << e.what() << std::endl;
+        slots_.clear();
+        return false;
+    }
+
+    free_slots_.reset(slots_.size());
+    queued_slots_.reset(slots_.size());
+    for (uint32_t i = 0; i < slots_.size(); i++)
+        free_slots_.push(i);
+    return true;
+}
+
+void FrameEncoder::start_workers(int n_workers)
+{
+    stop_ = false;
+    failed_ = false;
+    written_ = 0;
+    stalls_ = 0;
+    start_time_ = std::chrono::steady_clock::now();
+    for (int i = 0; i < std::min(n_workers, (int)slots_.size()); i++)
+        workers_.emplace_back(&FrameEncoder::worker_func, this);
+}
+
+void FrameEncoder::submit(const std::filesystem::path& file, const unsigned char* pixels)
+{
+    if (slots_.empty())
+        return;
+
+    // backpressure: wait for the next written frame instead of until all are written
+    uint32_t index;
+    if (!free_slots_.pop(index))
+    {
+        stalls_++;
+        std::unique_lock<std::mutex> lock(mutex_);
+        slot_freed_.wait(lock, [&] { return free_slots_.pop(index); });
+    }
+
+    Slot& slot = slots_[index];
+    std::copy(pixels, pixels + slot.pixels.size(), slot.pixels.begin());
+    slot.file = file;
+    queued_slots_.push(index);
+
+    // a worker that found the queue empty holds the mutex until it waits, so it can not miss this notification
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    frame_queued_.notify_one();
+}
+
+bool FrameEncoder::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    frame_queued_.notify_all();
+
+    // the workers empty the queue before they stop
+    for (auto& worker : workers_)
+        worker.join();
+    workers_.clear();
+    slots_.clear();
+
+    // closing stdin ends the video, pclose() waits until ffmpeg has written it
+    if (pipe_)
+    {
+        const int status = pclose(pipe_);
+        pipe_ = nullptr;
+        if (status != 0)
+        {
+            std::cerr << "Error: ffmpeg failed with status " << status << std::endl;
+            failed_ = true;
+        }
+    }
+    return !failed_;
+}
+
+double FrameEncoder::frames_per_second() const
+{
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+    return seconds > 0 ? written_ / seconds : 0;
+}
+
+void FrameEncoder::worker_func()
+{
+    while (true)
+    {
+        uint32_t index;
+        if (!queued_slots_.pop(index))
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            bool popped = false;
+            frame_queued_.wait(lock, [&] {
+                popped = queued_slots_.pop(index);
+                return popped || stop_;
+            });
+            if (!popped)
+                return;
+        }
+
+        write(slots_[index]);
+        written_++;
+        free_slots_.push(index);
+
+        // same as in submit(), the render loop may be waiting for this slot
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        slot_freed_.notify_one();
+    }
+}
+
+void FrameEncoder::write(const Slot& slot)
+{
+    bool ok;
+    if (pipe_)
+    {
+        // after a failed write ffmpeg is gone, the remaining frames are only dropped
+        if (failed_)
+            return;
+        ok = fwrite(slot.pixels.data(), 1, slot.pixels.size(), pipe_) == slot.pixels.size();
+        if (!ok)
+        {
+            std::cerr << "Error: Could not write to ffmpeg, the remaining frames are dropped" << std::endl;
+            failed_ = true;
+        }
+        return;
+    }
+
+    if (format_ == ".png")
+        ok = stbi_write_png(slot.file.c_str(), width_, height_, 3, slot.pixels.data(), 3 * width_);
+    else
+        ok = stbi_write_jpg(slot.file.c_str(), width_, height_, 3, slot.pixels.data(), 90);
+    if (!ok)
+    {
+        std::cerr << "Error: Could not write frame " << slot.file << std::endl;
+        failed_ = true;
+    }
+}
+
+} // namespace meshlife
@@ -12,9 +12,9 @@
 
 #include <imgui.h>
 #include <sstream>
-#include <stb_image_write.h>
 #include <thread>
 
+#include "meshlife/algorithms/helpers.h"
 #include "meshlife/algorithms/mesh_lenia.h"
 #include "meshlife/paths.h"
 #include "meshlife/stamps.h"
@@ -65,8 +65,6 @@ Viewer::Viewer(const char* title, int width, int height) : CustomMeshViewer(titl
     add_help_item("C", "Rotate camera (for Debugging)");
     add_help_item("B", "Place selected stamp on mesh");
 
-    clock_last_ = std::chrono::high_resolution_clock::now();
-
     selected_shader_path_vertex_ = shaders_path / PATH_SIMPLE_SHADER_VERTEX_;
     selected_shader_path_fragment_ = shaders_path / PATH_SIMPLE_SHADER_FRAGMENT_;
 
@@ -121,6 +119,7 @@ Viewer::~Viewer()
 void Viewer::on_close_callback()
 {
     stop_simulation();
+    stop_trajectory_recording();
     file_watcher_disable();
     if (thread_ffmpeg_.joinable())
     {
@@ -130,21 +129,31 @@ void Viewer::on_close_callback()
 
 void Viewer::start_recording()
 {
-    size_t size = (size_t)3 * (size_t)width() * (size_t)height() * (size_t)recording_buffer_count_;
-    try
+    if (!std::filesystem::exists(recordings_path_))
     {
-        recording_frame_data_.resize(size);
+        if (!std::filesystem::create_directory(recordings_path_))
+        {
+            std::cerr << "Error: failed to create directory to store recordings" << std::endl;
+            return;
+        }
+        std::cout << "Created directory to store recordings at: " << std::filesystem::absolute(recordings_path_)
+                  << std::endl;
     }
-    catch (std::bad_alloc& e)
+
+    // stream into ffmpeg if possible, image files are the fallback
+    bool started = false;
+    if (recording_stream_video_)
     {
-        std::cerr << "Error: Not enough memory for buffer\n" << e.what() << std::endl;
-        return;
+        started = frame_encoder_.start_video(
+            width(), height(), recording_buffer_count_, recording_framerate_, recordings_path_ / "output.mp4");
+        if (!started)
+            std::cerr << "Error: Can not stream to ffmpeg, recording image files instead" << std::endl;
     }
-    catch (std::length_error& e)
-    {
-        std::cerr << "Error: Not enough memory for buffer\n" << e.what() << std::endl;
+    if (!started && !frame_encoder_.start(width(), height(), recording_buffer_count_, recording_fileformat_))
         return;
-    }
+
+    // frames are read back a few frames late through a ring of pixel buffers
+    frame_capture_.start(width(), height());
 
     recording_start_time_ = std::chrono::system_clock::now();
     recording_image_counter_ = 0;
@@ -166,8 +175,21 @@ void Viewer::stop_recording()
 
     std::cout << "Recording stopped" << std::endl;
 
+    // the last frames are still being read back
+    frame_capture_.collect([this](int frame, const unsigned char* pixels) { store_captured_frame(frame, pixels); },
+                           true);
+
+    if (frame_encoder_.streaming())
+    {
+        // the video is complete once ffmpeg exits, there is nothing to convert
+        std::cout << "Waiting for ffmpeg to finish the video..." << std::endl;
+        if (frame_encoder_.finish())
+            std::cout << "Video saved to " << std::filesystem::absolute(recordings_path_ / "output.mp4") << std::endl;
+        return;
+    }
+
     std::cout << "Waiting for files to be written to disk..." << std::endl;
-    join_recording_buffer_threads();
+    frame_encoder_.finish();
     std::cout << "Frames have been written to disk." << std::endl;
 
     if (recording_create_video_)
@@ -194,19 +216,6 @@ void Viewer::stop_recording()
     }
 }
 
-void Viewer::join_recording_buffer_threads()
-{
-    while (!recording_buffer_threads_.empty())
-    {
-        std::thread& thread = *recording_buffer_threads_.top();
-        recording_buffer_threads_.pop();
-        if (thread.joinable())
-        {
-            thread.join();
-        }
-    }
-}
-
 void Viewer::delete_recorded_frames()
 {
     for (auto& filepath : std::filesystem::directory_iterator(recordings_path_))
@@ -339,11 +348,13 @@ void Viewer::start_simulation(bool single_step)
     {
         return;
     }
+    close_trajectory();
     simulation_running_ = true;
 
     if (single_step)
     {
         automaton_->update_state(1);
+        after_simulation_step();
         simulation_running_ = false;
     }
     else
@@ -352,27 +363,156 @@ void Viewer::start_simulation(bool single_step)
 
 void Viewer::simulation_thread_func()
 {
+    auto last_update = std::chrono::steady_clock::now();
+    auto next_update = last_update;
     while (simulation_running_)
     {
-        auto c_now = std::chrono::high_resolution_clock::now();
-        auto delta_clock_cycles = c_now - clock_last_;
-        auto delta_ms = (delta_clock_cycles / CLOCKS_PER_SEC).count();
-        // only start updating the state after it has been rendered, otherwise we start rendering and redraw mid
-        // frame
-        if (!ready_for_display_ && (unlimited_limit_UPS_ || (delta_ms >= (1000.0 / (double)UPS_))))
+        if (!unlimited_limit_UPS_)
         {
-            // std::cout << "Update state" << std::endl;
-            clock_last_ = std::chrono::high_resolution_clock::now();
-            automaton_->update_state(1);
-            current_UPS_ = 1000.0 / delta_ms;
-            ready_for_display_ = true;
+            // sleep until the next update is due, stop_simulation() wakes us up early
+            std::unique_lock<std::mutex> lock(simulation_mutex_);
+            if (simulation_wakeup_.wait_until(lock, next_update, [this] { return !simulation_running_; }))
+                break;
         }
+
+        automaton_->update_state(1);
+        after_simulation_step();
+        // the renderer picks up the newest published state whenever it draws, the simulation never waits for it.
+        // Steps it would not draw anyway are not copied.
+        automaton_->publish_state();
+
+        const auto now = std::chrono::steady_clock::now();
+        current_UPS_ = 1.0 / std::chrono::duration<double>(now - last_update).count();
+        last_update = now;
+        // do not try to catch up if an update took longer than the period
+        next_update = std::max(next_update + std::chrono::microseconds(1000000 / std::max(UPS_, 1)), now);
+    }
+
+    // the last step may have been skipped because the renderer had not drawn the one before
+    automaton_->publish_state(true);
+}
+
+void Viewer::after_simulation_step()
+{
+    const uint64_t step = ++simulation_step_;
+
+    std::lock_guard<std::mutex> lock(trajectory_mutex_);
+    if (trajectory_writer_.is_open())
+        trajectory_writer_.write(step, automaton_->state_prop().data());
+}
+
+void Viewer::start_trajectory_recording()
+{
+    std::lock_guard<std::mutex> lock(trajectory_mutex_);
+    const std::filesystem::path path = trajectory_path_;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path());
+    if (!trajectory_writer_.open(path, mesh_, (TrajectoryEncoding)trajectory_encoding_,
+                                 trajectory_compress_ ? TrajectoryCompression::DeltaRLE : TrajectoryCompression::None,
+                                 trajectory_parameters()))
+        return;
+
+    // the current state is the first frame, a running simulation appends the following ones. While it runs the state
+    // is being changed, then its next step is the first frame.
+    if (!simulation_running_)
+        trajectory_writer_.write(simulation_step_, automaton_->state_prop().data());
+    std::cout << "Recording trajectory to " << std::filesystem::absolute(path) << std::endl;
+}
+
+void Viewer::stop_trajectory_recording()
+{
+    std::lock_guard<std::mutex> lock(trajectory_mutex_);
+    if (!trajectory_writer_.is_open())
+        return;
+    std::cout << "Trajectory saved: " << trajectory_writer_.frames_written() << " frames, "
+              << trajectory_writer_.bytes_written() / 1024 << " KiB" << std::endl;
+    trajectory_writer_.close();
+}
+
+bool Viewer::open_trajectory(const std::filesystem::path& path)
+{
+    // the played frames replace the automaton state on screen
+    stop_simulation();
+    close_trajectory();
+
+    if (!trajectory_reader_.open(path))
+        return false;
+    if (!trajectory_reader_.matches(mesh_))
+    {
+        std::cerr << "Error: Trajectory " << path << " was recorded on another mesh ("
+                  << trajectory_reader_.header().n_faces_ << " faces)" << std::endl;
+        trajectory_reader_.close();
+        return false;
+    }
+    if (trajectory_reader_.n_frames() == 0)
+    {
+        std::cerr << "Error: Trajectory " << path << " contains no frames" << std::endl;
+        trajectory_reader_.close();
+        return false;
+    }
+
+    show_trajectory_frame(0);
+    return true;
+}
+
+void Viewer::show_trajectory_frame(int frame)
+{
+    trajectory_frame_ = std::clamp(frame, 0, (int)trajectory_reader_.n_frames() - 1);
+    if (trajectory_reader_.read(trajectory_frame_, trajectory_state_))
+        renderer_.update_state_buffer(trajectory_state_);
+    else
+        trajectory_playing_ = false;
+}
+
+void Viewer::close_trajectory()
+{
+    if (!trajectory_reader_.is_open())
+        return;
+    trajectory_reader_.close();
+    trajectory_playing_ = false;
+    // show the automaton state again
+    ready_for_display_ = true;
+}
+
+std::string Viewer::trajectory_parameters() const
+{
+    std::stringstream parameters;
+    if (auto* lenia = dynamic_cast<MeshLenia*>(automaton_))
+    {
+        parameters << "automaton=lenia\nmu=" << lenia->p_mu_ << "\nsigma=" << lenia->p_sigma_ << "\nT=" << lenia->p_T_
+                   << "\nradius=" << lenia->p_neighborhood_radius_ / lenia->average_edge_length_ << "\npeaks=";
+        for (size_t i = 0; i < lenia->p_beta_peaks_.size(); i++)
+            parameters << (i ? "," : "") << lenia->p_beta_peaks_[i];
+        parameters << "\n";
     }
+    else
+        parameters << "automaton=gol\nlower=" << automaton_->p_lower_threshold_
+                   << "\nupper=" << automaton_->p_upper_threshold_ << "\n";
+    return parameters.str();
+}
+
+void Viewer::update_lenia_kernel(MeshLenia& lenia, bool radius_changed)
+{
+    // the simulation thread reads the kernel, pause it while the kernel is rebuilt
+    const bool was_running = simulation_running_;
+    stop_simulation();
+
+    if (radius_changed)
+        lenia.update_neighborhood_radius();
+    else
+        lenia.kernel_precompute();
+
+    if (was_running)
+        start_simulation();
 }
 
 void Viewer::stop_simulation()
 {
-    simulation_running_ = false;
+    {
+        std::lock_guard<std::mutex> lock(simulation_mutex_);
+        simulation_running_ = false;
+    }
+    simulation_wakeup_.notify_all();
     if (simulation_thread_.joinable())
         simulation_thread_.join();
 }
@@ -391,11 +531,17 @@ void Viewer::reload_shader()
 
 void Viewer::set_mesh_properties()
 {
-    if (!mesh_.has_face_property("f:color"))
-    {
-        mesh_.add_face_property("f:color", pmp::Color{1, 1, 1});
-        renderer_.update_opengl_buffers();
-    }
+    // recorded and played trajectories refer to the faces of the old mesh
+    stop_trajectory_recording();
+    close_trajectory();
+
+    // sort faces spatially before the automaton caches anything by face index, the state is permuted along
+    if (reorder_faces_)
+        helpers::reorder_faces_spatially(mesh_);
+
+    if (auto* lenia = dynamic_cast<MeshLenia*>(automaton_))
+        lenia->p_neighborhood_cache_ = mesh_file_;
+
     if (automaton_)
         automaton_->allocate_needed_properties();
 }
@@ -558,6 +704,7 @@ void Viewer::keyboard(int key, int scancode, int action, int mods)
         pmp::BoundingBox bb = bounds(mesh_);
         set_scene((pmp::vec3)bb.center(), 0.5 * bb.size());
         // set_draw_mode("Hidden Line");
+        mesh_file_.clear();
         set_mesh_properties();
         update_mesh();
 
@@ -571,97 +718,51 @@ void Viewer::keyboard(int key, int scancode, int action, int mods)
         break;
     }
     }
-
-    if (!mesh_.has_face_property("f:color"))
-    {
-        mesh_.add_face_property("f:color", pmp::Color{1, 1, 1});
-        renderer_.update_opengl_buffers();
-    }
 }
 
 void Viewer::do_processing()
 {
 
-    // do_processing gets called every draw frame (most likely 60fps) so this limits the update rate
-    // ready_for_display gets set to true every time the simulation thread finishes one update, so we limit
-    // redraw calls to be in sync with the simulation delay. uncomplete_updates is used to circumvent this sync
-    // behaviour and allows to redraw the state[] array while it still gets updated in the simulation thread
-    if (uncomplete_updates_ || ready_for_display_)
-    {
-        // reset update flag
-        ready_for_display_ = false;
+    // GUI actions change the state on this thread and request a redraw, a running simulation thread publishes by
+    // itself after every update
+    if (ready_for_display_.exchange(false) && automaton_ && !simulation_running_)
+        automaton_->publish_state(true);
 
-        // calculate raninbow colors for each face
-        if (automaton_)
+    if (trajectory_reader_.is_open())
+    {
+        // advance by the elapsed time, so the speed does not depend on the frame rate
+        const auto now = std::chrono::steady_clock::now();
+        if (trajectory_playing_)
         {
-            for (auto f : mesh_.faces())
+            const int frames = std::chrono::duration<double>(now - trajectory_last_advance_).count() * trajectory_fps_;
+            if (frames > 0)
             {
-                auto state = automaton_->state(f);
-                float v = std::clamp(state, 0.0f, 1.0f);
-                // make hsv rainbow color
-                set_face_color(f, hsv_to_rgb((int)(v * 360 + 270) % 360, state, 1));
+                trajectory_last_advance_ = now;
+                if (trajectory_frame_ + 1 >= (int)trajectory_reader_.n_frames())
+                    trajectory_playing_ = false;
+                else
+                    show_trajectory_frame(trajectory_frame_ + frames);
             }
         }
-        // redraw new state
-        renderer_.update_opengl_buffers();
-    }
-
-    // TODO: DELETE THIS? CHANGE REDRAW BEHAVIOUR TO UPDATE FOR SHADERS
-    //  redraw new state
-    renderer_.update_opengl_buffers();
-}
-
-pmp::Color Viewer::hsv_to_rgb(float h, float s, float v)
-{
-    float c = v * s;
-    float x = c * (1 - std::abs(std::fmod(h / 60.0, 2) - 1));
-    float m = v - c;
-
-    float r, g, b;
-    if (h >= 0 && h < 60)
-    {
-        r = c;
-        g = x;
-        b = 0;
-    }
-    else if (h >= 60 && h < 120)
-    {
-        r = x;
-        g = c;
-        b = 0;
-    }
-    else if (h >= 120 && h < 180)
-    {
-        r = 0;
-        g = c;
-        b = x;
-    }
-    else if (h >= 180 && h < 240)
-    {
-        r = 0;
-        g = x;
-        b = c;
-    }
-    else if (h >= 240 && h < 300)
-    {
-        r = x;
-        g = 0;
-        b = c;
-    }
-    else
-    {
-        r = c;
-        g = 0;
-        b = x;
+        else
+            trajectory_last_advance_ = now;
+        return;
     }
 
-    return pmp::Color{r + m, g + m, b + m};
+    // only upload when a new state was published, the published state never changes while we read it.
+    // The faces are colored on the GPU, so this is a plain copy of 4 bytes per face.
+    if (automaton_ && automaton_->update_published_state())
+        renderer_.update_state_buffer(automaton_->published_state());
 }
 
 void Viewer::drop(int count, const char** paths)
 {
     CustomMeshViewer::drop(count, paths);
+    if (count > 0)
+        mesh_file_ = paths[count - 1];
     set_mesh_properties();
+    // load_mesh() uploaded the buffers before the faces were reordered
+    update_mesh();
 }
 
 void Viewer::after_display()
@@ -670,43 +771,14 @@ void Viewer::after_display()
     {
         // increment before so we start at frame 1
         recording_image_counter_++;
-        std::stringstream filename;
-        filename << "frame_" << std::setw(6) << std::setfill('0') << recording_image_counter_ << recording_fileformat_;
-        if (!std::filesystem::exists(recordings_path_))
-        {
-            if (!std::filesystem::create_directory(recordings_path_))
-            {
-                std::cerr << "Error: failed to create directory to store recordings" << std::endl;
-                return;
-            }
-            std::cout << "Created directory to store recordings at: " << std::filesystem::absolute(recordings_path_)
-                      << std::endl;
-        }
 
-        std::filesystem::path file = recordings_path_ / filename.str();
+        // queue the readback of this frame and store the ones whose readback finished, which are a few frames
+        // behind. The GPU continues with the next frames meanwhile.
         auto time = renderer_.get_itime();
-        // allocate buffer
-
-        recording_buffer_used_++;
-
-        int buffer_idx = recording_buffer_used_ - 1;
-        // read framebuffer
-        glfwMakeContextCurrent(window_);
-        glPixelStorei(GL_PACK_ALIGNMENT, 1);
-        // offset in bytes because buffer is vector of unsigned char
-        size_t offset = (size_t)buffer_idx * (size_t)width() * (size_t)height() * (size_t)3;
-        glReadnPixels(
-            0, 0, width(), height(), GL_RGB, GL_UNSIGNED_BYTE, width() * height() * 3, &recording_frame_data_[offset]);
+        const auto store = [this](int frame, const unsigned char* pixels) { store_captured_frame(frame, pixels); };
+        frame_capture_.read(recording_image_counter_, store);
+        frame_capture_.collect(store);
 
-        recording_buffer_threads_.emplace(new std::thread(&Viewer::write_frame_to_file, this, file, buffer_idx));
-
-        // TODO: This is not optimal but good enough (use something like a thread pool instead)
-        // if buffers are full, wait until they're completely empty again
-        if (recording_buffer_used_ == recording_buffer_count_)
-        {
-            join_recording_buffer_threads();
-            recording_buffer_used_ = 0;
-        }
         renderer_.set_itime(time + 1.0 / (double)recording_framerate_);
 
         if ((recording_frame_target_count_ > 0) && (recording_image_counter_ >= recording_frame_target_count_))
@@ -714,20 +786,19 @@ void Viewer::after_display()
     }
 }
 
-void Viewer::write_frame_to_file(std::filesystem::path filename, int buffer_idx)
+void Viewer::store_captured_frame(int frame, const unsigned char* pixels)
 {
-    // write to file
-    stbi_flip_vertically_on_write(true);
-    // offset in bytes because buffer is vector of unsigned char
-    size_t offset = (size_t)buffer_idx * (size_t)width() * (size_t)height() * (size_t)3;
-    if (recording_fileformat_ == ".png")
+    if (frame_encoder_.streaming())
     {
-        stbi_write_png(filename.c_str(), width(), height(), 3, &recording_frame_data_[offset], 3 * width());
-    }
-    else
-    {
-        stbi_write_jpg(filename.c_str(), width(), height(), 3, &recording_frame_data_[offset], 90);
+        frame_encoder_.submit({}, pixels);
+        return;
     }
+
+    std::stringstream filename;
+    filename << "frame_" << std::setw(6) << std::setfill('0') << frame << recording_fileformat_;
+
+    // the mapped pixel buffer is only valid during this call, the encoder copies it into one of its slots
+    frame_encoder_.submit(recordings_path_ / filename.str(), pixels);
 }
 
 void Viewer::read_mesh_from_file(std::string path)
@@ -737,6 +808,7 @@ void Viewer::read_mesh_from_file(std::string path)
     if (std::filesystem::exists(file))
     {
         pmp::read(mesh_, file);
+        mesh_file_ = file;
         set_mesh_properties();
         update_mesh();
     }
@@ -806,7 +878,7 @@ void Viewer::process_imgui()
         ImGui::Text("Calculated FPS: %.0f", renderer_.get_framerate());
         IMGUI_TOOLTIP_TEXT("This FPS is calculated with the time between the last two draw calls")
         ImGui::Separator();
-        ImGui::Text("Current UPS (Simulation): %.0f", current_UPS_);
+        ImGui::Text("Current UPS (Simulation): %.0f", current_UPS_.load());
         IMGUI_TOOLTIP_TEXT("This FPS is calculated with the time between the last two draw calls")
         ImGui::Separator();
         ImGui::Text("iTime (Shader): %.2f", renderer_.get_itime());
@@ -851,6 +923,12 @@ void Viewer::process_imgui()
             ImGui::Separator();
 
             ImGui::BeginDisabled(recording_);
+            ImGui::Checkbox("Stream frames to ffmpeg (requires ffmpeg in path)", &recording_stream_video_);
+            ImGui::EndDisabled();
+            IMGUI_TOOLTIP_TEXT("Encodes the video while recording, without image files. Falls back to image files if "
+                               "ffmpeg can not be started.")
+
+            ImGui::BeginDisabled(recording_ || recording_stream_video_);
             ImGui::Checkbox("Automatically convert frames to video (requires ffmpeg in path)",
                             &recording_create_video_);
             ImGui::EndDisabled();
@@ -887,8 +965,8 @@ void Viewer::process_imgui()
             ImGui::InputInt("Recording target framecount", &recording_frame_target_count_, 0, 0);
             IMGUI_TOOLTIP_TEXT("Amount of frames to record. Use 0 for infinte (you have to manually stop recording)")
             ImGui::SliderInt("Recording target buffer count", &recording_buffer_count_, 1, 5000);
-            IMGUI_TOOLTIP_TEXT(
-                "Amount of frames to buffer. Increasing this number directly corresponds with higher RAM usage.")
+            IMGUI_TOOLTIP_TEXT("Amount of frames to buffer while they are encoded. Increasing this number directly "
+                               "corresponds with higher RAM usage.")
             ImGui::EndDisabled();
             {
                 std::stringstream ram_usage;
@@ -909,9 +987,18 @@ void Viewer::process_imgui()
             {
                 {
                     std::stringstream buffer_used;
-                    buffer_used << "Buffer used: " << recording_buffer_used_ << '/' << recording_buffer_count_;
+                    buffer_used << "Buffer used: " << frame_encoder_.queued() << '/' << frame_encoder_.slot_count();
                     ImGui::Text("%s", buffer_used.str().c_str());
                 }
+                {
+                    std::stringstream encoder;
+                    encoder << "Encoded: " << frame_encoder_.written() << " frames, " << std::fixed
+                            << std::setprecision(1) << frame_encoder_.frames_per_second() << " FPS ("
+                            << frame_encoder_.worker_count() << " threads)";
+                    ImGui::Text("%s", encoder.str().c_str());
+                }
+                ImGui::Text("Waited for the encoder: %zu times", frame_encoder_.stalls());
+                IMGUI_TOOLTIP_TEXT("The render loop waits for a free buffer whenever the encoder falls behind")
                 ImGui::Text("Frame: %d/%d", recording_image_counter_, recording_frame_target_count_);
                 {
                     std::stringstream recordingtime;
@@ -1038,7 +1125,7 @@ void Viewer::process_imgui()
                 renderer_.mesh_size_y_ = 1.0;
                 renderer_.mesh_size_z_ = 1.0;
                 set_mesh_scale(1.0);
-                update_mesh();
+                update_mesh(false);
             }
 
             if (ImGui::SliderFloat("Mesh scale Uniformly:", &renderer_.mesh_size_uniform_, 0.01, 40))
@@ -1049,26 +1136,26 @@ void Viewer::process_imgui()
                 renderer_.mesh_size_y_ = renderer_.mesh_size_uniform_;
                 renderer_.mesh_size_z_ = renderer_.mesh_size_uniform_;
                 set_mesh_scale(scaling);
-                update_mesh();
+                update_mesh(false);
             }
 
             if (ImGui::SliderFloat("Mesh scale X:", &renderer_.mesh_size_x_, 0.01, 40))
             {
                 pmp::vec3 scaling = pmp::vec3(renderer_.mesh_size_x_, renderer_.mesh_size_y_, renderer_.mesh_size_z_);
                 set_mesh_scale(scaling);
-                update_mesh();
+                update_mesh(false);
             }
             if (ImGui::SliderFloat("Mesh scale Y:", &renderer_.mesh_size_y_, 0.01, 40))
             {
                 pmp::vec3 scaling = pmp::vec3(renderer_.mesh_size_x_, renderer_.mesh_size_y_, renderer_.mesh_size_z_);
                 set_mesh_scale(scaling);
-                update_mesh();
+                update_mesh(false);
             }
             if (ImGui::SliderFloat("Mesh scale Z:", &renderer_.mesh_size_z_, 0.01, 40))
             {
                 pmp::vec3 scaling = pmp::vec3(renderer_.mesh_size_x_, renderer_.mesh_size_y_, renderer_.mesh_size_z_);
                 set_mesh_scale(scaling);
-                update_mesh();
+                update_mesh(false);
             }
 
             if (ImGui::Button(rotate_around_center_ ? "Rotate around Center: ON" : "Rotate around Center: OFF"))
@@ -1182,6 +1269,17 @@ void Viewer::process_imgui()
             ImGui::SliderFloat("alpha", &renderer_.alpha_, 0, 1);
             ImGui::Checkbox("Use Lighting", &renderer_.use_lighting_);
             ImGui::Checkbox("Use Vertex Color", &renderer_.use_colors_);
+
+            if (ImGui::BeginCombo("Colormap", renderer_.colormap_names_[(int)renderer_.colormap_].c_str()))
+            {
+                for (int i = 0; i < (int)Colormap::COUNT; i++)
+                {
+                    if (ImGui::Selectable(renderer_.colormap_names_[i].c_str(), (int)renderer_.colormap_ == i))
+                        renderer_.colormap_ = (Colormap)i;
+                }
+                ImGui::EndCombo();
+            }
+            IMGUI_TOOLTIP_TEXT("Maps the automaton state of each face to its color");
         }
 
         ImGui::Spacing();
@@ -1190,16 +1288,6 @@ void Viewer::process_imgui()
         if (ImGui::CollapsingHeader("UPS Settings (for simulation)"))
         {
             {
-                // std::stringstream label;
-                // label << "Unrestricted render updates (allows visual  update mid-calculation): "
-                //       << (uncomplete_updates_ ? "ON" : "OFF") << ")";
-                // if (ImGui::Button(label.str().c_str()))
-                // {
-                //     uncomplete_updates_ = !uncomplete_updates_;
-                // }
-                // IMGUI_TOOLTIP_TEXT("(HAS NO EFFECT ANYMORE)");
-            } {
-
                 std::stringstream limit_ups_text;
                 limit_ups_text << "Unlimited UPS (Current: " << (unlimited_limit_UPS_ ? "ON" : "OFF") << ")";
                 if (ImGui::Button(limit_ups_text.str().c_str()))
@@ -1216,6 +1304,85 @@ void Viewer::process_imgui()
         ImGui::Spacing();
         ImGui::Spacing();
 
+        if (ImGui::CollapsingHeader("Trajectory"))
+        {
+            ImGui::InputText("Trajectory File", trajectory_path_, sizeof(trajectory_path_));
+
+            bool recording_trajectory;
+            {
+                std::lock_guard<std::mutex> lock(trajectory_mutex_);
+                recording_trajectory = trajectory_writer_.is_open();
+                if (recording_trajectory)
+                    ImGui::Text("Recorded %zu frames (%lu KiB)", trajectory_writer_.frames_written(),
+                                (unsigned long)(trajectory_writer_.bytes_written() / 1024));
+            }
+
+            ImGui::BeginDisabled(recording_trajectory);
+            ImGui::Combo("Encoding", &trajectory_encoding_, "Float (lossless)\0UInt8 (8 bit)\0Bits (alive or dead)\0");
+            ImGui::Checkbox("Delta Compression", &trajectory_compress_);
+            IMGUI_TOOLTIP_TEXT("Stores the changes to the previous step run length encoded, with a full state every 32 "
+                               "steps. Much smaller for slowly changing states.");
+            ImGui::EndDisabled();
+
+            if (ImGui::Button(recording_trajectory ? "Stop Recording Trajectory" : "Record Trajectory"))
+            {
+                if (recording_trajectory)
+                    stop_trajectory_recording();
+                else
+                    start_trajectory_recording();
+            }
+            IMGUI_TOOLTIP_TEXT("Writes the state after every simulation step to the file, which can be played back "
+                               "later without simulating");
+
+            ImGui::SameLine();
+            ImGui::BeginDisabled(recording_trajectory);
+            if (ImGui::Button("Open for Playback"))
+                open_trajectory(trajectory_path_);
+            ImGui::EndDisabled();
+
+            if (trajectory_reader_.is_open())
+            {
+                ImGui::Separator();
+                ImGui::Text("Step %lu", (unsigned long)trajectory_reader_.step(trajectory_frame_));
+                int frame = trajectory_frame_;
+                if (ImGui::SliderInt("Frame", &frame, 0, (int)trajectory_reader_.n_frames() - 1))
+                    show_trajectory_frame(frame);
+
+                if (ImGui::Button(trajectory_playing_ ? "Pause" : "Play"))
+                {
+                    if (!trajectory_playing_ && trajectory_frame_ + 1 >= (int)trajectory_reader_.n_frames())
+                        show_trajectory_frame(0);
+                    trajectory_playing_ = !trajectory_playing_;
+                }
+                ImGui::SameLine();
+                ImGui::PushItemWidth(150);
+                ImGui::SliderFloat("Frames per Second", &trajectory_fps_, 1, 1000, "%.0f",
+                                   ImGuiSliderFlags_Logarithmic);
+                ImGui::PopItemWidth();
+
+                if (ImGui::Button("Load Frame into Automaton"))
+                {
+                    for (auto f : mesh_.faces())
+                        automaton_->set_state(f, trajectory_state_[f.idx()]);
+                    simulation_step_ = trajectory_reader_.step(trajectory_frame_);
+                    close_trajectory();
+                }
+                IMGUI_TOOLTIP_TEXT("Continues the simulation from the shown state");
+                ImGui::SameLine();
+                if (ImGui::Button("Close Playback"))
+                    close_trajectory();
+
+                if (ImGui::TreeNode("Parameters"))
+                {
+                    ImGui::TextUnformatted(trajectory_reader_.parameters().c_str());
+                    ImGui::TreePop();
+                }
+            }
+        }
+
+        ImGui::Spacing();
+        ImGui::Spacing();
+
         if (ImGui::CollapsingHeader("Debug Info (Press D on a face)"))
         {
             if (debug_data_.face_.is_valid())
@@ -1329,6 +1496,7 @@ void Viewer::process_imgui()
                     std::cerr << e.what() << std::endl;
                     return;
                 }
+                set_mesh_properties();
                 update_mesh();
             }
         }
@@ -1349,21 +1517,21 @@ void Viewer::process_imgui()
                     std::cerr << e.what() << std::endl;
                     return;
                 }
-                automaton_->allocate_needed_properties();
+                set_mesh_properties();
                 update_mesh();
             }
 
             if (ImGui::Button("Quad-Tri Subdivision"))
             {
                 quad_tri_subdivision(mesh_);
-                automaton_->allocate_needed_properties();
+                set_mesh_properties();
                 update_mesh();
             }
 
             if (ImGui::Button("Catmull-Clark Subdivision"))
             {
                 catmull_clark_subdivision(mesh_);
-                automaton_->allocate_needed_properties();
+                set_mesh_properties();
                 update_mesh();
             }
         }
@@ -1389,6 +1557,7 @@ void Viewer::process_imgui()
                     std::cerr << e.what() << std::endl;
                     return;
                 }
+                set_mesh_properties();
                 update_mesh();
             }
 
@@ -1408,6 +1577,7 @@ void Viewer::process_imgui()
                     std::cerr << e.what() << std::endl;
                     return;
                 }
+                set_mesh_properties();
                 update_mesh();
             }
         }
@@ -1436,6 +1606,7 @@ void Viewer::process_imgui()
             if (ImGui::Button("Next"))
             {
                 automaton_->update_state(1);
+                after_simulation_step();
                 ready_for_display_ = true;
             }
 
@@ -1459,6 +1630,11 @@ void Viewer::process_imgui()
             {
                 automaton_->p_upper_threshold_ = automaton_->p_lower_threshold_;
             }
+
+            ImGui::PushItemWidth(100);
+            ImGui::SliderInt("Brush Size", &brush_size_, 0, 10);
+            ImGui::PopItemWidth();
+            IMGUI_TOOLTIP_TEXT("Rings of neighbor faces painted alive with Ctrl + right mouse drag");
         }
 
         ImGui::Spacing();
@@ -1470,6 +1646,7 @@ void Viewer::process_imgui()
             {
                 pmp::dual(mesh_);
                 set_mesh_properties();
+                update_mesh();
             }
             IMGUI_TOOLTIP_TEXT("Converts the current mesh to its dual mesh variant");
         }
@@ -1484,6 +1661,9 @@ void Viewer::process_imgui()
                 read_mesh_from_file(std::string(modelpath_buf_));
             }
             IMGUI_TOOLTIP_TEXT("Loads the model as current mesh. Drag&Drop'ing the mesh file is also supported.");
+            ImGui::Checkbox("Reorder Faces", &reorder_faces_);
+            IMGUI_TOOLTIP_TEXT("Sorts the faces along a space filling curve after loading, subdivision and remeshing. "
+                               "Neighboring faces are then close in memory, which speeds up the simulation.");
         }
 
         if (auto* lenia = dynamic_cast<MeshLenia*>(automaton_))
@@ -1502,17 +1682,34 @@ void Viewer::process_imgui()
                 ImGui::SliderFloat("Sigma", &lenia->p_sigma_, 0, 1);
                 ImGui::SliderInt("T", &lenia->p_T_, 1, 50);
 
-                // TODO: recalculate neighbors
-                float neighborhood_radius = lenia->p_neighborhood_radius_ / lenia->average_edge_length_;
-                ImGui::SliderFloat("Neighborhood Radius", &neighborhood_radius, 0, 20);
-                lenia->p_neighborhood_radius_ = neighborhood_radius * lenia->average_edge_length_;
-                if (ImGui::Button("Recalculate Neighborhood"))
+                if (ImGui::BeginCombo("Backend", simd::backend_name(lenia->p_backend_)))
                 {
-                    // TODO: move a_gol to a better place
-                    stop_simulation();
-                    lenia->allocate_needed_properties();
+                    for (int i = 0; i < (int)LeniaBackend::COUNT; i++)
+                    {
+                        const auto backend = (LeniaBackend)i;
+                        if (!simd::is_supported(backend))
+                            continue;
+                        if (ImGui::Selectable(simd::backend_name(backend), lenia->p_backend_ == backend))
+                            lenia->p_backend_ = backend;
+                    }
+                    ImGui::EndCombo();
                 }
-                IMGUI_TOOLTIP_TEXT("Manually recalculates the neighboorhood map for the lenia simulation.");
+                IMGUI_TOOLTIP_TEXT("Implementation of the kernel convolution. Auto picks AVX2 if this CPU supports it. "
+                                   "AVX-512 is usually slower and only used when selected.");
+
+                float neighborhood_radius = lenia->p_neighborhood_radius_ / lenia->average_edge_length_;
+                if (ImGui::SliderFloat("Neighborhood Radius", &neighborhood_radius, 0, 20))
+                    lenia->p_neighborhood_radius_ = neighborhood_radius * lenia->average_edge_length_;
+                // a smaller radius only filters the neighbor lists, apply it right away
+                if (ImGui::IsItemDeactivatedAfterEdit()
+                    && lenia->p_neighborhood_radius_ < lenia->neighborhood_radius_computed())
+                    update_lenia_kernel(*lenia, true);
+                IMGUI_TOOLTIP_TEXT("In mean edge lengths. Smaller radii are applied immediately, larger ones need "
+                                   "the neighborhoods to be recalculated.");
+                if (ImGui::Button("Recalculate Neighborhood"))
+                    update_lenia_kernel(*lenia, true);
+                IMGUI_TOOLTIP_TEXT("Applies the radius to the neighboorhood map for the lenia simulation. Only a "
+                                   "larger radius or a changed mesh computes the distances again.");
                 ImGui::LabelText("Avg. Neighbor count:", "%d", lenia->neighbor_count_avg_);
 
                 if (ImGui::Button("Visualize Kernel Shell"))
@@ -1549,6 +1746,9 @@ void Viewer::process_imgui()
                         s2 += std::to_string(peak) + ",";
                     }
                     strcpy(peak_string_, s2.c_str());
+
+                    // the distances do not depend on the peaks, only the weights are computed again
+                    update_lenia_kernel(*lenia, false);
                 }
 
                 {
@@ -1683,27 +1883,18 @@ void Viewer::process_imgui()
     }
 }
 
-void Viewer::set_face_color(pmp::Face& face, pmp::Color color)
-{
-    auto color_property = mesh_.get_face_property<pmp::Color>("f:color");
-    // std::cout << colorProperty[face] << std::endl;
-    color_property[face] = color;
-}
-
 void Viewer::mouse(int button, int action, int mods)
 {
     if (action == GLFW_PRESS && button == GLFW_MOUSE_BUTTON_RIGHT && Window::ctrl_pressed())
     {
         double x, y;
         cursor_pos(x, y);
-        pmp::Vertex v = pick_vertex(x, y);
-        if (mesh_.is_valid(v))
+        pmp::Face face;
+        if (find_face(x, y, face))
         {
-            // You can do something with the picked vertex here
-            pmp::Face face;
-            find_face(x, y, face);
-            // TODO: maybe convert to method
-            automaton_->set_state(face, 1.0);
+            // keep painting while the button is held, see motion()
+            painting_ = true;
+            paint_faces(face);
             if (auto* lenia = dynamic_cast<MeshLenia*>(automaton_))
             {
                 lenia->highlight_neighbors(face);
@@ -1713,31 +1904,70 @@ void Viewer::mouse(int button, int action, int mods)
     }
     else
     {
+        if (action == GLFW_RELEASE && button == GLFW_MOUSE_BUTTON_RIGHT)
+        {
+            painting_ = false;
+            last_painted_face_ = pmp::Face();
+        }
         CustomMeshViewer::mouse(button, action, mods);
     }
 }
 
-bool Viewer::find_face(int x, int y, pmp::Face& face)
+void Viewer::motion(double x, double y)
 {
-    pmp::vec3 p;
-    pmp::Face fmin;
-    pmp::Scalar d, dmin(std::numeric_limits<pmp::Scalar>::max());
+    if (!painting_)
+    {
+        CustomMeshViewer::motion(x, y);
+        return;
+    }
 
-    if (TrackballViewer::pick(x, y, p))
+    // picking is a single pixel read from the face index pass, cheap enough for every motion event
+    pmp::Face face;
+    if (find_face(x, y, face) && face != last_painted_face_)
+        paint_faces(face);
+}
+
+void Viewer::paint_faces(pmp::Face face)
+{
+    if (!automaton_)
+        return;
+
+    // the face and brush_size_ rings of edge neighbors around it
+    std::vector<pmp::Face> faces = {face};
+    size_t ring_begin = 0;
+    for (int ring = 0; ring < brush_size_; ring++)
     {
-        pmp::Point picked_position(p);
-        for (auto f : mesh_.faces())
+        const size_t ring_end = faces.size();
+        for (size_t i = ring_begin; i < ring_end; i++)
         {
-            // TODO: This will not always return the correct face
-            d = distance(pmp::centroid(mesh_, f), picked_position);
-            if (d < dmin)
+            for (auto h : mesh_.halfedges(faces[i]))
             {
-                dmin = d;
-                fmin = f;
+                const pmp::Face neighbor = mesh_.face(mesh_.opposite_halfedge(h));
+                if (neighbor.is_valid() && std::find(faces.begin(), faces.end(), neighbor) == faces.end())
+                    faces.push_back(neighbor);
             }
         }
+        ring_begin = ring_end;
     }
-    face = fmin;
-    return true;
+
+    for (auto f : faces)
+        automaton_->set_state(f, 1.0);
+    last_painted_face_ = face;
+    ready_for_display_ = true;
+}
+
+bool Viewer::find_face(int x, int y, pmp::Face& face)
+{
+    // exactly the face drawn at the pixel, read from the renderer's face index pass
+    face = renderer_.pick_face(x, y);
+    if (face.is_valid() || renderer_.pick_pass_available())
+        return face.is_valid();
+
+    // without the pass (e.g. in draw modes without triangles), take the face whose centroid is closest to the picked
+    // point. This is not always the face under the cursor and scans all faces
+    pmp::vec3 p;
+    if (TrackballViewer::pick(x, y, p))
+        face = helpers::nearest_face(mesh_, pmp::Point(p));
+    return face.is_valid();
 }
 } // namespace meshlife